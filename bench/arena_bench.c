@@ -0,0 +1,1009 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdalign.h>
+#include <string.h>
+#include "../include/arena.h"
+#include "../include/platform.h"
+#include "../include/pool.h"
+#include "../include/dynamicarray.h"
+
+// Headless allocator benchmarks and stress tests, each benchmark reports one result per measured configuration
+//
+// Usage - arena_bench [--csv | --json] [--suite name] [maxEntities]
+//
+// Results are printed as aligned text by default, --csv and --json print the same
+// suite/name/param/value/unit fields in a form that can be diffed between releases.
+// The process exits with 1 if the stress suite finds a problem
+
+#define DEFAULT_ENTITIES 65536
+#define BENCH_COMPONENTS 7
+#define SWEEP_REPEATS 50
+#define CONCURRENT_PUSHES 1000000
+#define MAX_BENCH_THREADS 64
+#define CHURN_SLOTS 4096
+#define CHURN_OPS 4000000
+#define CHAINED_PUSHES 1000000
+#define CHAINED_ROUNDS 10
+#define SNAPSHOT_REPEATS 20
+// Entities changed between two snapshots, about what a few ticks of gameplay touch
+#define SNAPSHOT_CHANGED 64
+#define ARRAY_ELEMENTS 1000000
+#define ARRAY_ROUNDS 10
+#define ARRAY_CHUNK 1024
+#define PUSH_BYTES (64 * 1024 * 1024)
+#define FAULT_BYTES (64 * 1024 * 1024)
+#define REUSE_CYCLES 10000
+#define REUSE_PUSHES 1000
+#define OVERHEAD_OBJECTS 250000
+#define STRESS_OPS 500000
+#define STRESS_LIVE 4096
+#define STRESS_VERIFY_INTERVAL 65536
+
+// The one-element-at-a-time macros dynamicarray.h used to have, kept as a baseline
+#define LEGACY_RESERVE_SIZE (1ULL * 1024ULL * 1024ULL * 1024ULL)
+#define LegacyInitDynamicArray(dynamicArray, type) {\
+    dynamicArray.arena = ArenaAllocParams((ArenaParams){ .reserveSize = LEGACY_RESERVE_SIZE });\
+    dynamicArray.values = (type *)dynamicArray.arena->arena;\
+    dynamicArray.len = 0;\
+    dynamicArray.capacity = 0;\
+}
+#define LegacyPushArrayDynamic(dynamicArray, type, value) {\
+    PushStruct(dynamicArray.arena, type);\
+    dynamicArray.capacity++;\
+    dynamicArray.values[dynamicArray.len] = value;\
+    dynamicArray.len++;\
+}
+#define LegacyDynamicResize(dynamicArray, type, size) {\
+    if (dynamicArray.capacity > size)\
+    {\
+        ArenaPop(dynamicArray.arena, (dynamicArray.capacity - size) * sizeof(type));\
+        if (dynamicArray.len >= size) dynamicArray.len = size;\
+    }\
+    else\
+    {\
+        PushArray(dynamicArray.arena, type, size - dynamicArray.capacity);\
+    }\
+    dynamicArray.capacity = size;\
+}
+
+// Stand-in for an average component, about the size of Position
+typedef struct BenchComponent
+{
+    float values[8];
+} BenchComponent;
+
+// Same layout the ECS builds in GameLoop, sparse maps in one arena and component data in another
+typedef struct BenchWorld
+{
+    uint32_t *entityToIndex[BENCH_COMPONENTS];
+    uint32_t *indexToEntity[BENCH_COMPONENTS];
+    BenchComponent *data[BENCH_COMPONENTS];
+    uint32_t size;
+} BenchWorld;
+
+typedef enum BenchFormat
+{
+    BENCH_FORMAT_TEXT = 0,
+    BENCH_FORMAT_CSV = 1,
+    BENCH_FORMAT_JSON = 2
+} BenchFormat;
+
+static BenchFormat benchFormat = BENCH_FORMAT_TEXT;
+static uint32_t benchResults = 0;
+// Set by the stress suite when it finds a problem, becomes the exit code
+static bool benchFailed = false;
+
+static void BenchReport(const char *suite, const char *name, uint64_t param, double value, const char *unit)
+{
+    switch (benchFormat)
+    {
+    case BENCH_FORMAT_CSV:
+        printf("%s,%s,%llu,%.3f,%s\n", suite, name, (unsigned long long)param, value, unit);
+        break;
+    case BENCH_FORMAT_JSON:
+        printf("%s    {\"suite\": \"%s\", \"name\": \"%s\", \"param\": %llu, \"value\": %.3f, \"unit\": \"%s\"}",
+               benchResults > 0 ? ",\n" : "", suite, name, (unsigned long long)param, value, unit);
+        break;
+    default:
+        printf("%-12s %-40s %10llu %14.3f %s\n", suite, name, (unsigned long long)param, value, unit);
+        break;
+    }
+
+    benchResults++;
+    fflush(stdout);
+}
+
+static uint32_t BenchRandom(uint32_t *state)
+{
+    // xorshift32, deterministic so every configuration sees the same shuffle
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static bool BuildWorld(BenchWorld *world, Arena *ecsArena, Arena *componentArena, uint32_t maxEntities)
+{
+    uint32_t seed = 0x12345678;
+    world->size = maxEntities;
+
+    for (int c = 0; c < BENCH_COMPONENTS; c++)
+    {
+        world->entityToIndex[c] = PushArray(ecsArena, uint32_t, maxEntities);
+        world->indexToEntity[c] = PushArray(ecsArena, uint32_t, maxEntities);
+        world->data[c] = PushArrayZero(componentArena, BenchComponent, maxEntities);
+        if (world->entityToIndex[c] == NULL || world->indexToEntity[c] == NULL || world->data[c] == NULL) return false;
+
+        // Entities are added in a random order, like a world that has been running for a while
+        for (uint32_t i = 0; i < maxEntities; i++) world->indexToEntity[c][i] = i;
+        for (uint32_t i = maxEntities - 1; i > 0; i--)
+        {
+            uint32_t j = BenchRandom(&seed) % (i + 1);
+            uint32_t tmp = world->indexToEntity[c][i];
+            world->indexToEntity[c][i] = world->indexToEntity[c][j];
+            world->indexToEntity[c][j] = tmp;
+        }
+        for (uint32_t i = 0; i < maxEntities; i++) world->entityToIndex[c][world->indexToEntity[c][i]] = i;
+    }
+
+    return true;
+}
+
+// Multi-component system sweep, walk one component densely and look up the next one through the sparse map
+static float SweepWorld(BenchWorld *world)
+{
+    float sum = 0.0f;
+    for (int c = 0; c < BENCH_COMPONENTS; c++)
+    {
+        int other = (c + 1) % BENCH_COMPONENTS;
+        for (uint32_t i = 0; i < world->size; i++)
+        {
+            uint32_t entity = world->indexToEntity[c][i];
+            uint32_t otherIndex = world->entityToIndex[other][entity];
+            world->data[c][i].values[0] += world->data[other][otherIndex].values[1];
+            sum += world->data[c][i].values[0];
+        }
+    }
+
+    return sum;
+}
+
+// Huge pages vs regular pages for the ECS and component arenas
+static void BenchHugePages(uint32_t maxEntities)
+{
+    const struct { const char *name; uint32_t flags; } modes[] = {
+        { "default_pages", ARENA_DEFAULT },
+        { "huge_pages", ARENA_HUGE_PAGES },
+        { "huge_pages_explicit", ARENA_HUGE_PAGES_EXPLICIT },
+    };
+
+    for (uint32_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        ArenaParams params = { .reserveSize = 1ULL << 32, .flags = modes[m].flags };
+        Arena *ecsArena = ArenaAllocParams(params);
+        Arena *componentArena = ArenaAllocParams(params);
+        if (ecsArena == NULL || componentArena == NULL)
+        {
+            fprintf(stderr, "%s: could not reserve arenas\n", modes[m].name);
+            continue;
+        }
+
+        BenchWorld world;
+        uint64_t buildStart = PlatformTimeNs();
+        if (!BuildWorld(&world, ecsArena, componentArena, maxEntities))
+        {
+            fprintf(stderr, "%s: could not build world\n", modes[m].name);
+            continue;
+        }
+        uint64_t buildEnd = PlatformTimeNs();
+
+        // Warm up once so page faults are not part of the sweep time
+        volatile float sink = SweepWorld(&world);
+
+        uint64_t start = PlatformTimeNs();
+        for (int r = 0; r < SWEEP_REPEATS; r++) sink += SweepWorld(&world);
+        uint64_t end = PlatformTimeNs();
+        (void)sink;
+
+        double perEntity = (double)(end - start) / ((double)SWEEP_REPEATS * BENCH_COMPONENTS * maxEntities);
+        char name[64];
+        snprintf(name, sizeof(name), "sweep.%s", modes[m].name);
+        BenchReport("hugepages", name, maxEntities, perEntity, "ns/entity");
+        snprintf(name, sizeof(name), "build.%s", modes[m].name);
+        BenchReport("hugepages", name, maxEntities, (double)(buildEnd - buildStart) / 1000000.0, "ms");
+
+        ArenaDealloc(ecsArena);
+        ArenaDealloc(componentArena);
+    }
+}
+
+// World creation under different commit policies, mimics ECSInit's many small per-entity pushes
+// followed by the first sweep, which is where first-touch page faults land
+static void BenchCommitPolicy(uint32_t maxEntities)
+{
+    const struct { const char *name; uint64_t commitSize; uint32_t flags; } policies[] = {
+        { "commit_page", 4096, ARENA_DEFAULT },
+        { "commit_64k", 64 * 1024, ARENA_DEFAULT },
+        { "commit_2m", 2 * 1024 * 1024, ARENA_DEFAULT },
+        { "commit_2m_prefault", 2 * 1024 * 1024, ARENA_PREFAULT },
+        { "commit_2m_huge_prefault", 2 * 1024 * 1024, ARENA_HUGE_PAGES | ARENA_PREFAULT },
+    };
+
+    for (uint32_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++)
+    {
+        ArenaParams params = { .reserveSize = 1ULL << 32, .commitSize = policies[p].commitSize, .flags = policies[p].flags };
+
+        uint64_t start = PlatformTimeNs();
+        Arena *ecsArena = ArenaAllocParams(params);
+        Arena *componentArena = ArenaAllocParams(params);
+        if (ecsArena == NULL || componentArena == NULL)
+        {
+            fprintf(stderr, "%s: could not reserve arenas\n", policies[p].name);
+            continue;
+        }
+
+        // One small push per entity, like the per-entity signatures ECSInit used to make
+        for (uint32_t i = 0; i < maxEntities; i++)
+        {
+            char *signature = PushArrayZero(ecsArena, char, BENCH_COMPONENTS);
+            if (signature == NULL) break;
+        }
+
+        BenchWorld world;
+        if (!BuildWorld(&world, ecsArena, componentArena, maxEntities))
+        {
+            fprintf(stderr, "%s: could not build world\n", policies[p].name);
+            continue;
+        }
+        volatile float sink = SweepWorld(&world);
+        (void)sink;
+        uint64_t end = PlatformTimeNs();
+
+        BenchReport("commit", policies[p].name, maxEntities, (double)(end - start) / 1000000.0, "ms");
+
+        // Memory footprint of the world, so allocator overhead regressions show up next to the timings
+        ArenaStats stats = ArenaGetStats(ecsArena);
+        char name[64];
+        snprintf(name, sizeof(name), "%s.ecs_committed", policies[p].name);
+        BenchReport("memory", name, maxEntities, (double)stats.committed / 1024.0, "KB");
+        snprintf(name, sizeof(name), "%s.ecs_padding", policies[p].name);
+        BenchReport("memory", name, maxEntities, (double)stats.paddingBytes / 1024.0, "KB");
+
+        ArenaDealloc(ecsArena);
+        ArenaDealloc(componentArena);
+    }
+}
+
+// Cost of snapshotting and restoring a whole world, taking a full snapshot, an incremental one
+// after a few entities changed, and restoring, at the world sizes in snapshotEntities
+static void BenchSnapshot(uint32_t maxEntities)
+{
+    (void)maxEntities;
+    const uint32_t snapshotEntities[] = { 1024, 16384, 65536 };
+
+    for (uint32_t s = 0; s < sizeof(snapshotEntities) / sizeof(snapshotEntities[0]); s++)
+    {
+        uint32_t entities = snapshotEntities[s];
+        ArenaParams params = { .reserveSize = 1ULL << 32 };
+        Arena *ecsArena = ArenaAllocParams(params);
+        Arena *componentArena = ArenaAllocParams(params);
+        BenchWorld world;
+        if (ecsArena == NULL || componentArena == NULL || !BuildWorld(&world, ecsArena, componentArena, entities))
+        {
+            fprintf(stderr, "snapshot: could not build world of %u\n", entities);
+            continue;
+        }
+
+        Arena *arenas[] = { ecsArena, componentArena };
+        ArenaCheckpoint checkpoints[2] = { 0 };
+        uint64_t fullTime = 0;
+        uint64_t incrementalTime = 0;
+        uint64_t restoreTime = 0;
+        uint64_t dirtyPages = 0;
+        uint32_t seed = 0x9E3779B9;
+        for (int r = 0; r < SNAPSHOT_REPEATS; r++)
+        {
+            // Fresh checkpoints every round so the full snapshot copies everything
+            for (int a = 0; a < 2; a++) ArenaCheckpointFree(&checkpoints[a]);
+
+            uint64_t start = PlatformTimeNs();
+            for (int a = 0; a < 2; a++) ArenaSnapshot(arenas[a], &checkpoints[a]);
+            uint64_t end = PlatformTimeNs();
+            fullTime += end - start;
+
+            for (int i = 0; i < SNAPSHOT_CHANGED; i++)
+            {
+                world.data[BenchRandom(&seed) % BENCH_COMPONENTS][BenchRandom(&seed) % entities].values[0] += 1.0f;
+            }
+
+            start = PlatformTimeNs();
+            for (int a = 0; a < 2; a++) ArenaSnapshot(arenas[a], &checkpoints[a]);
+            end = PlatformTimeNs();
+            incrementalTime += end - start;
+            dirtyPages += checkpoints[0].dirtyPages + checkpoints[1].dirtyPages;
+
+            SweepWorld(&world);
+
+            start = PlatformTimeNs();
+            for (int a = 0; a < 2; a++) ArenaRestore(arenas[a], &checkpoints[a]);
+            end = PlatformTimeNs();
+            restoreTime += end - start;
+        }
+
+        BenchReport("snapshot", "full", entities, (double)fullTime / (SNAPSHOT_REPEATS * 1000.0), "us");
+        BenchReport("snapshot", "incremental", entities, (double)incrementalTime / (SNAPSHOT_REPEATS * 1000.0), "us");
+        BenchReport("snapshot", "incremental_dirty_pages", entities, (double)dirtyPages / SNAPSHOT_REPEATS, "pages");
+        BenchReport("snapshot", "restore", entities, (double)restoreTime / (SNAPSHOT_REPEATS * 1000.0), "us");
+        BenchReport("snapshot", "size", entities, (double)(ecsArena->offset + componentArena->offset) / 1024.0, "KB");
+
+        for (int a = 0; a < 2; a++) ArenaCheckpointFree(&checkpoints[a]);
+        ArenaDealloc(ecsArena);
+        ArenaDealloc(componentArena);
+    }
+}
+
+// Small record like an event or a spawned entity's component, pushed from every thread
+typedef struct BenchRecord
+{
+    uint32_t entity;
+    uint32_t type;
+    float x;
+    float y;
+} BenchRecord;
+
+typedef struct ConcurrentWorker
+{
+    PlatformThread thread;
+    Arena *arena;
+    uint32_t index;
+    volatile bool *start;
+    uint64_t failed;
+} ConcurrentWorker;
+
+// One big reservation vs chains of smaller blocks, for pushes, rewinding and a world sweep.
+// Rewinding with Clear each round shows the cost of crossing block boundaries again
+static void BenchChainedBlocks(uint32_t maxEntities)
+{
+    const struct { const char *name; ArenaParams params; } backends[] = {
+        { "reserve", { .reserveSize = 1ULL << 32 } },
+        { "chained_64k", { .blockSize = 64 * 1024, .flags = ARENA_CHAINED } },
+        { "chained_4m", { .blockSize = 4 * 1024 * 1024, .flags = ARENA_CHAINED } },
+    };
+
+    for (uint32_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+    {
+        Arena *arena = ArenaAllocParams(backends[b].params);
+        if (arena == NULL)
+        {
+            fprintf(stderr, "%s: could not reserve arena\n", backends[b].name);
+            continue;
+        }
+
+        uint64_t failed = 0;
+        uint64_t start = PlatformTimeNs();
+        for (int r = 0; r < CHAINED_ROUNDS; r++)
+        {
+            for (uint32_t i = 0; i < CHAINED_PUSHES; i++)
+            {
+                BenchRecord *record = PushStruct(arena, BenchRecord);
+                if (record == NULL)
+                {
+                    failed++;
+                    continue;
+                }
+                record->entity = i;
+            }
+            ArenaClear(arena);
+        }
+        uint64_t end = PlatformTimeNs();
+
+        char name[64];
+        snprintf(name, sizeof(name), "push.%s", backends[b].name);
+        BenchReport("chained", name, CHAINED_PUSHES, (double)(end - start) / ((double)CHAINED_ROUNDS * CHAINED_PUSHES), "ns/push");
+        if (failed > 0) fprintf(stderr, "%s: %llu pushes failed\n", backends[b].name, (unsigned long long)failed);
+
+        ArenaDealloc(arena);
+
+        Arena *ecsArena = ArenaAllocParams(backends[b].params);
+        Arena *componentArena = ArenaAllocParams(backends[b].params);
+        BenchWorld world;
+        if (ecsArena == NULL || componentArena == NULL || !BuildWorld(&world, ecsArena, componentArena, maxEntities))
+        {
+            fprintf(stderr, "%s: could not build world\n", backends[b].name);
+            continue;
+        }
+
+        volatile float sink = SweepWorld(&world);
+        start = PlatformTimeNs();
+        for (int r = 0; r < SWEEP_REPEATS; r++) sink += SweepWorld(&world);
+        end = PlatformTimeNs();
+        (void)sink;
+
+        snprintf(name, sizeof(name), "sweep.%s", backends[b].name);
+        BenchReport("chained", name, maxEntities, (double)(end - start) / ((double)SWEEP_REPEATS * BENCH_COMPONENTS * maxEntities), "ns/entity");
+
+        // Address space is what the chained backend saves, so show how much each one holds
+        ArenaStats stats = ArenaGetStats(componentArena);
+        snprintf(name, sizeof(name), "%s.component_reserved", backends[b].name);
+        BenchReport("memory", name, maxEntities, (double)stats.reserved / 1024.0, "KB");
+
+        ArenaDealloc(ecsArena);
+        ArenaDealloc(componentArena);
+    }
+}
+
+DynamicArrayDefine(DynamicRecords, BenchRecord);
+
+typedef struct LegacyRecords
+{
+    Arena *arena;
+    BenchRecord *values;
+    int32_t len;
+    int32_t capacity;
+} LegacyRecords;
+
+// The old per-element macros against the geometrically growing array, pushing one at a time,
+// appending in chunks, resizing in one go, and two arrays sharing an arena so they have to move
+static void BenchDynamicArray(uint32_t maxEntities)
+{
+    (void)maxEntities;
+    uint64_t legacyPush = 0, legacyResize = 0;
+    uint64_t dynamicPush = 0, dynamicAppend = 0, dynamicResize = 0, dynamicShared = 0;
+    BenchRecord chunk[ARRAY_CHUNK] = { 0 };
+    volatile uint32_t sink = 0;
+
+    for (int r = 0; r < ARRAY_ROUNDS; r++)
+    {
+        LegacyRecords legacy;
+        LegacyInitDynamicArray(legacy, BenchRecord);
+        uint64_t start = PlatformTimeNs();
+        for (uint32_t i = 0; i < ARRAY_ELEMENTS; i++) LegacyPushArrayDynamic(legacy, BenchRecord, ((BenchRecord){ .entity = i }));
+        legacyPush += PlatformTimeNs() - start;
+        sink += legacy.values[legacy.len - 1].entity;
+        ArenaDealloc(legacy.arena);
+
+        LegacyInitDynamicArray(legacy, BenchRecord);
+        start = PlatformTimeNs();
+        LegacyDynamicResize(legacy, BenchRecord, ARRAY_ELEMENTS);
+        legacy.values[ARRAY_ELEMENTS - 1].entity = 1;
+        legacyResize += PlatformTimeNs() - start;
+        ArenaDealloc(legacy.arena);
+
+        Arena *arena = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 32 });
+        DynamicRecords records;
+        DynamicArrayInit(records, arena);
+        start = PlatformTimeNs();
+        for (uint32_t i = 0; i < ARRAY_ELEMENTS; i++) DynamicArrayPush(records, ((BenchRecord){ .entity = i }));
+        dynamicPush += PlatformTimeNs() - start;
+        sink += records.values[records.len - 1].entity;
+
+        ArenaClear(arena);
+        DynamicArrayInit(records, arena);
+        start = PlatformTimeNs();
+        for (uint32_t i = 0; i < ARRAY_ELEMENTS; i += ARRAY_CHUNK) DynamicArrayAppend(records, chunk, ARRAY_CHUNK);
+        dynamicAppend += PlatformTimeNs() - start;
+
+        ArenaClear(arena);
+        DynamicArrayInit(records, arena);
+        start = PlatformTimeNs();
+        DynamicArrayResize(records, ARRAY_ELEMENTS);
+        records.values[ARRAY_ELEMENTS - 1].entity = 1;
+        dynamicResize += PlatformTimeNs() - start;
+
+        ArenaClear(arena);
+        DynamicRecords other;
+        DynamicArrayInit(records, arena);
+        DynamicArrayInit(other, arena);
+        start = PlatformTimeNs();
+        for (uint32_t i = 0; i < ARRAY_ELEMENTS / 2; i++)
+        {
+            DynamicArrayPush(records, ((BenchRecord){ .entity = i }));
+            DynamicArrayPush(other, ((BenchRecord){ .entity = i }));
+        }
+        dynamicShared += PlatformTimeNs() - start;
+        sink += other.values[other.len - 1].entity;
+
+        ArenaDealloc(arena);
+    }
+    (void)sink;
+
+    double elements = (double)ARRAY_ROUNDS * ARRAY_ELEMENTS;
+    BenchReport("dynarray", "push.legacy", ARRAY_ELEMENTS, (double)legacyPush / elements, "ns/element");
+    BenchReport("dynarray", "push.dynamic", ARRAY_ELEMENTS, (double)dynamicPush / elements, "ns/element");
+    BenchReport("dynarray", "push.dynamic_shared_arena", ARRAY_ELEMENTS, (double)dynamicShared / elements, "ns/element");
+    BenchReport("dynarray", "append.dynamic", ARRAY_ELEMENTS, (double)dynamicAppend / elements, "ns/element");
+    BenchReport("dynarray", "resize.legacy", ARRAY_ELEMENTS, (double)legacyResize / (ARRAY_ROUNDS * 1000.0), "us");
+    BenchReport("dynarray", "resize.dynamic", ARRAY_ELEMENTS, (double)dynamicResize / (ARRAY_ROUNDS * 1000.0), "us");
+}
+
+static void ConcurrentPushWorker(void *arg)
+{
+    ConcurrentWorker *worker = arg;
+    while (!*worker->start) PlatformThreadYield();
+
+    for (uint32_t i = 0; i < CONCURRENT_PUSHES; i++)
+    {
+        BenchRecord *record = PushStruct(worker->arena, BenchRecord);
+        if (record == NULL)
+        {
+            worker->failed++;
+            continue;
+        }
+        *record = (BenchRecord){ i, worker->index, (float)i, (float)worker->index };
+    }
+}
+
+// Contention on one ARENA_CONCURRENT arena from 1 to N threads, each pushing small records
+static void BenchConcurrentPush(uint32_t maxEntities)
+{
+    (void)maxEntities;
+    // Single threaded baseline on a regular arena
+    Arena *plain = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 36 });
+    uint64_t start = PlatformTimeNs();
+    for (uint32_t i = 0; i < CONCURRENT_PUSHES; i++)
+    {
+        BenchRecord *record = PushStruct(plain, BenchRecord);
+        *record = (BenchRecord){ i, 0, (float)i, 0.0f };
+    }
+    uint64_t end = PlatformTimeNs();
+    BenchReport("concurrent", "push.plain", 1, (double)(end - start) / CONCURRENT_PUSHES, "ns/push");
+    ArenaDealloc(plain);
+
+    uint32_t maxThreads = PlatformProcessorCount();
+    if (maxThreads > MAX_BENCH_THREADS) maxThreads = MAX_BENCH_THREADS;
+
+    static ConcurrentWorker workers[MAX_BENCH_THREADS];
+    for (uint32_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        Arena *shared = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 36, .flags = ARENA_CONCURRENT });
+        volatile bool go = false;
+
+        for (uint32_t t = 0; t < threads; t++)
+        {
+            workers[t] = (ConcurrentWorker){ .arena = shared, .index = t, .start = &go };
+            PlatformThreadCreate(&workers[t].thread, ConcurrentPushWorker, &workers[t]);
+        }
+
+        start = PlatformTimeNs();
+        go = true;
+        uint64_t failed = 0;
+        for (uint32_t t = 0; t < threads; t++)
+        {
+            PlatformThreadJoin(&workers[t].thread);
+            failed += workers[t].failed;
+        }
+        end = PlatformTimeNs();
+
+        if (failed > 0) fprintf(stderr, "concurrent: %llu pushes failed\n", (unsigned long long)failed);
+
+        double totalPushes = (double)threads * CONCURRENT_PUSHES;
+        BenchReport("concurrent", "push.shared", threads, (double)(end - start) / totalPushes, "ns/push");
+        BenchReport("concurrent", "throughput.shared", threads, totalPushes / ((double)(end - start) / 1000.0), "Mpush/s");
+
+        ArenaDealloc(shared);
+    }
+}
+
+// Churn-heavy workload, a fixed number of live slots where every op frees a random slot
+// and allocates a new random size into it, like event payloads and console lines
+static void BenchPoolChurn(uint32_t maxEntities)
+{
+    (void)maxEntities;
+    static void *slots[CHURN_SLOTS];
+    static uint32_t sizes[CHURN_SLOTS];
+
+    // malloc baseline
+    uint32_t seed = 0xC0FFEE;
+    for (int i = 0; i < CHURN_SLOTS; i++)
+    {
+        sizes[i] = 16 + BenchRandom(&seed) % 496;
+        slots[i] = malloc(sizes[i]);
+    }
+    uint64_t start = PlatformTimeNs();
+    for (int op = 0; op < CHURN_OPS; op++)
+    {
+        uint32_t slot = BenchRandom(&seed) % CHURN_SLOTS;
+        free(slots[slot]);
+        sizes[slot] = 16 + BenchRandom(&seed) % 496;
+        slots[slot] = malloc(sizes[slot]);
+        ((unsigned char *)slots[slot])[0] = (unsigned char)op;
+    }
+    uint64_t end = PlatformTimeNs();
+    for (int i = 0; i < CHURN_SLOTS; i++) free(slots[i]);
+    BenchReport("pool", "churn.malloc", CHURN_SLOTS, (double)(end - start) / CHURN_OPS, "ns/op");
+
+    // Pool on an arena, same sequence of sizes
+    Arena *arena = ArenaAlloc();
+    Pool pool;
+    PoolInit(&pool, arena);
+    seed = 0xC0FFEE;
+    for (int i = 0; i < CHURN_SLOTS; i++)
+    {
+        sizes[i] = 16 + BenchRandom(&seed) % 496;
+        slots[i] = PoolAlloc(&pool, sizes[i]);
+    }
+    start = PlatformTimeNs();
+    for (int op = 0; op < CHURN_OPS; op++)
+    {
+        uint32_t slot = BenchRandom(&seed) % CHURN_SLOTS;
+        PoolFree(&pool, slots[slot], sizes[slot]);
+        sizes[slot] = 16 + BenchRandom(&seed) % 496;
+        slots[slot] = PoolAlloc(&pool, sizes[slot]);
+        ((unsigned char *)slots[slot])[0] = (unsigned char)op;
+    }
+    end = PlatformTimeNs();
+    BenchReport("pool", "churn.pool", CHURN_SLOTS, (double)(end - start) / CHURN_OPS, "ns/op");
+    BenchReport("pool", "churn.pool_committed", CHURN_SLOTS, (double)arena->committed / 1024.0, "KB");
+    ArenaDealloc(arena);
+}
+
+// Push throughput for every size and alignment in pushSizes and pushAligns, with and without zeroing.
+// The arena is filled once before timing so commits and page faults are not part of it
+static void BenchPushThroughput(uint32_t maxEntities)
+{
+    (void)maxEntities;
+    const uint64_t pushSizes[] = { 8, 24, 64, 256, 4096 };
+    const uint64_t pushAligns[] = { 1, 8, 16, 64 };
+
+    Arena *arena = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 32 });
+    if (arena == NULL)
+    {
+        fprintf(stderr, "push: could not reserve arena\n");
+        return;
+    }
+    memset(ArenaPush(arena, PUSH_BYTES * 2, 1), 0, PUSH_BYTES * 2);
+    ArenaClear(arena);
+
+    for (uint32_t z = 0; z < 2; z++)
+    {
+        for (uint32_t a = 0; a < sizeof(pushAligns) / sizeof(pushAligns[0]); a++)
+        {
+            for (uint32_t p = 0; p < sizeof(pushSizes) / sizeof(pushSizes[0]); p++)
+            {
+                uint64_t pushes = PUSH_BYTES / pushSizes[p];
+                volatile uintptr_t sink = 0;
+
+                uint64_t start = PlatformTimeNs();
+                for (uint64_t i = 0; i < pushes; i++)
+                {
+                    void *ptr = z ? ArenaPushZero(arena, pushSizes[p], pushAligns[a]) : ArenaPush(arena, pushSizes[p], pushAligns[a]);
+                    sink += (uintptr_t)ptr;
+                }
+                uint64_t end = PlatformTimeNs();
+                (void)sink;
+                ArenaClear(arena);
+
+                char name[64];
+                snprintf(name, sizeof(name), "%s.align%llu", z ? "push_zero" : "push", (unsigned long long)pushAligns[a]);
+                BenchReport("push", name, pushSizes[p], (double)(end - start) / (double)pushes, "ns/push");
+            }
+        }
+    }
+
+    ArenaDealloc(arena);
+}
+
+// Cost of first touching freshly committed memory, touching it again after ArenaClear,
+// and touching it again after ArenaDecommit gave it back, per 4KB of memory
+static void BenchPageFaults(uint32_t maxEntities)
+{
+    (void)maxEntities;
+    const struct { const char *name; uint64_t commitSize; uint32_t flags; } policies[] = {
+        { "commit_64k", 64 * 1024, ARENA_DEFAULT },
+        { "commit_2m", 2 * 1024 * 1024, ARENA_DEFAULT },
+        { "commit_2m_prefault", 2 * 1024 * 1024, ARENA_PREFAULT },
+        { "commit_2m_huge", 2 * 1024 * 1024, ARENA_HUGE_PAGES },
+    };
+    const uint64_t touchStride = 4096;
+    const double pages = (double)FAULT_BYTES / touchStride;
+
+    for (uint32_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++)
+    {
+        Arena *arena = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 32, .commitSize = policies[p].commitSize, .flags = policies[p].flags });
+        if (arena == NULL)
+        {
+            fprintf(stderr, "fault: could not reserve arena for %s\n", policies[p].name);
+            continue;
+        }
+
+        const char *phases[] = { "first_touch", "reuse_touch", "after_decommit" };
+        for (uint32_t phase = 0; phase < 3; phase++)
+        {
+            if (phase == 2) ArenaDecommit(arena, 0);
+
+            uint64_t start = PlatformTimeNs();
+            for (uint64_t pushed = 0; pushed < FAULT_BYTES; pushed += 64 * 1024)
+            {
+                unsigned char *chunk = ArenaPush(arena, 64 * 1024, 64);
+                for (uint64_t i = 0; i < 64 * 1024; i += touchStride) chunk[i] = 1;
+            }
+            uint64_t end = PlatformTimeNs();
+            ArenaClear(arena);
+
+            char name[64];
+            snprintf(name, sizeof(name), "%s.%s", phases[phase], policies[p].name);
+            BenchReport("fault", name, FAULT_BYTES / 1024, (double)(end - start) / pages, "ns/4KB");
+        }
+
+        ArenaDealloc(arena);
+    }
+}
+
+// Frame-like cycles of many small random pushes followed by ArenaClear,
+// against malloc and free of the same sizes
+static void BenchClearReuse(uint32_t maxEntities)
+{
+    (void)maxEntities;
+    static void *allocs[REUSE_PUSHES];
+    uint32_t seed = 0xFEEDBEEF;
+
+    Arena *arena = ArenaAlloc();
+    uint64_t start = PlatformTimeNs();
+    for (int c = 0; c < REUSE_CYCLES; c++)
+    {
+        for (int i = 0; i < REUSE_PUSHES; i++)
+        {
+            unsigned char *ptr = ArenaPush(arena, 16 + BenchRandom(&seed) % 496, 16);
+            ptr[0] = (unsigned char)i;
+        }
+        ArenaClear(arena);
+    }
+    uint64_t end = PlatformTimeNs();
+    ArenaDealloc(arena);
+    BenchReport("reuse", "clear_cycle.arena", REUSE_PUSHES, (double)(end - start) / REUSE_CYCLES, "ns/cycle");
+
+    seed = 0xFEEDBEEF;
+    start = PlatformTimeNs();
+    for (int c = 0; c < REUSE_CYCLES; c++)
+    {
+        for (int i = 0; i < REUSE_PUSHES; i++)
+        {
+            allocs[i] = malloc(16 + BenchRandom(&seed) % 496);
+            ((unsigned char *)allocs[i])[0] = (unsigned char)i;
+        }
+        for (int i = 0; i < REUSE_PUSHES; i++) free(allocs[i]);
+    }
+    end = PlatformTimeNs();
+    BenchReport("reuse", "clear_cycle.malloc", REUSE_PUSHES, (double)(end - start) / REUSE_CYCLES, "ns/cycle");
+}
+
+// Resident memory per object for many small objects from malloc, an arena and a pool.
+// Measured as the growth in resident memory, so the numbers include allocator headers and slack.
+// Nothing from malloc is freed until the end, otherwise later sizes would reuse the freed memory
+static void BenchMemoryOverhead(uint32_t maxEntities)
+{
+    (void)maxEntities;
+    const uint64_t objectSizes[] = { 16, 48, 200 };
+    static void *objects[3][OVERHEAD_OBJECTS];
+
+    if (PlatformResidentBytes() == 0)
+    {
+        fprintf(stderr, "overhead: resident memory is not available on this platform\n");
+        return;
+    }
+
+    for (uint32_t o = 0; o < sizeof(objectSizes) / sizeof(objectSizes[0]); o++)
+    {
+        uint64_t size = objectSizes[o];
+
+        uint64_t before = PlatformResidentBytes();
+        for (int i = 0; i < OVERHEAD_OBJECTS; i++)
+        {
+            objects[o][i] = malloc(size);
+            memset(objects[o][i], 1, size);
+        }
+        uint64_t after = PlatformResidentBytes();
+        BenchReport("overhead", "malloc", size, (double)(after - before) / OVERHEAD_OBJECTS, "bytes/object");
+
+        Arena *arena = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 32 });
+        before = PlatformResidentBytes();
+        for (int i = 0; i < OVERHEAD_OBJECTS; i++) memset(ArenaPush(arena, size, 16), 1, size);
+        after = PlatformResidentBytes();
+        BenchReport("overhead", "arena", size, (double)(after - before) / OVERHEAD_OBJECTS, "bytes/object");
+        ArenaDealloc(arena);
+
+        arena = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 32 });
+        Pool pool;
+        PoolInit(&pool, arena);
+        before = PlatformResidentBytes();
+        for (int i = 0; i < OVERHEAD_OBJECTS; i++) memset(PoolAlloc(&pool, size), 1, size);
+        after = PlatformResidentBytes();
+        BenchReport("overhead", "pool", size, (double)(after - before) / OVERHEAD_OBJECTS, "bytes/object");
+        ArenaDealloc(arena);
+    }
+
+    for (uint32_t o = 0; o < sizeof(objectSizes) / sizeof(objectSizes[0]); o++)
+    {
+        for (int i = 0; i < OVERHEAD_OBJECTS; i++) free(objects[o][i]);
+    }
+}
+
+// Allocation still alive in the stress suite, filled with a pattern derived from seed
+typedef struct StressAlloc
+{
+    unsigned char *ptr;
+    uint64_t size;
+    uint64_t offsetBefore;
+    uint32_t seed;
+} StressAlloc;
+
+static bool StressCheck(StressAlloc *alloc)
+{
+    for (uint64_t i = 0; i < alloc->size; i++)
+    {
+        if (alloc->ptr[i] != (unsigned char)(alloc->seed + i)) return false;
+    }
+
+    return true;
+}
+
+// Random pushes, zeroed pushes, pops, temps, clears and decommits on one arena,
+// checking alignment, zeroing and that no live allocation is ever overwritten
+static uint64_t StressArena(Arena *arena, const char *name)
+{
+    static StressAlloc live[STRESS_LIVE];
+    uint32_t liveCount = 0;
+    uint32_t seed = 0xA5A5A5A5;
+    uint64_t failures = 0;
+
+    for (uint32_t op = 0; op < STRESS_OPS; op++)
+    {
+        uint32_t roll = BenchRandom(&seed) % 100;
+        if (roll < 60 && liveCount < STRESS_LIVE)
+        {
+            // Mostly small sizes with the odd large one that crosses commit and block boundaries
+            uint64_t size = (roll < 1) ? 1 + BenchRandom(&seed) % (256 * 1024) : 1 + BenchRandom(&seed) % 512;
+            uint64_t align = 1ULL << (BenchRandom(&seed) % 9);
+            bool zero = (BenchRandom(&seed) % 4) == 0;
+
+            uint64_t offsetBefore = arena->offset;
+            unsigned char *ptr = zero ? ArenaPushZero(arena, size, align) : ArenaPush(arena, size, align);
+            if (ptr == NULL || ((uintptr_t)ptr & (align - 1)) != 0)
+            {
+                fprintf(stderr, "stress %s: op %u bad push of %llu aligned to %llu\n", name, op, (unsigned long long)size, (unsigned long long)align);
+                failures++;
+                continue;
+            }
+            if (zero)
+            {
+                for (uint64_t i = 0; i < size; i++)
+                {
+                    if (ptr[i] == 0) continue;
+                    fprintf(stderr, "stress %s: op %u zeroed push is not zero\n", name, op);
+                    failures++;
+                    break;
+                }
+            }
+
+            StressAlloc *alloc = &live[liveCount++];
+            *alloc = (StressAlloc){ ptr, size, offsetBefore, BenchRandom(&seed) };
+            for (uint64_t i = 0; i < size; i++) ptr[i] = (unsigned char)(alloc->seed + i);
+        }
+        else if (roll < 90 && liveCount > 0)
+        {
+            // Pop the newest allocations, sometimes through a temp, sometimes through ArenaPop
+            uint32_t popCount = 1 + BenchRandom(&seed) % (liveCount < 8 ? liveCount : 8);
+            liveCount -= popCount;
+            if (roll % 2 == 0) ArenaTempEnd((ArenaTemp){ arena, live[liveCount].offsetBefore });
+            else ArenaPop(arena, arena->offset - live[liveCount].offsetBefore);
+        }
+        else if (roll < 91)
+        {
+            ArenaClear(arena);
+            liveCount = 0;
+        }
+        else if (roll < 92)
+        {
+            if (!ArenaDecommit(arena, 0))
+            {
+                fprintf(stderr, "stress %s: op %u decommit failed\n", name, op);
+                failures++;
+            }
+        }
+
+        if (op % STRESS_VERIFY_INTERVAL == 0 || op == STRESS_OPS - 1)
+        {
+            for (uint32_t i = 0; i < liveCount; i++)
+            {
+                if (StressCheck(&live[i])) continue;
+                fprintf(stderr, "stress %s: op %u allocation %u was overwritten\n", name, op, i);
+                failures++;
+            }
+        }
+    }
+
+    return failures;
+}
+
+static void BenchStress(uint32_t maxEntities)
+{
+    (void)maxEntities;
+    const struct { const char *name; ArenaParams params; } backends[] = {
+        { "reserve", { .reserveSize = 1ULL << 32 } },
+        { "reserve_page_commit", { .reserveSize = 1ULL << 32, .commitSize = 4096 } },
+        { "chained_64k", { .blockSize = 64 * 1024, .flags = ARENA_CHAINED } },
+    };
+
+    for (uint32_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+    {
+        Arena *arena = ArenaAllocParams(backends[b].params);
+        if (arena == NULL)
+        {
+            fprintf(stderr, "stress: could not reserve arena for %s\n", backends[b].name);
+            benchFailed = true;
+            continue;
+        }
+
+        uint64_t start = PlatformTimeNs();
+        uint64_t failures = StressArena(arena, backends[b].name);
+        uint64_t end = PlatformTimeNs();
+        ArenaDealloc(arena);
+
+        char name[64];
+        snprintf(name, sizeof(name), "failures.%s", backends[b].name);
+        BenchReport("stress", name, STRESS_OPS, (double)failures, "failures");
+        snprintf(name, sizeof(name), "ops.%s", backends[b].name);
+        BenchReport("stress", name, STRESS_OPS, (double)(end - start) / STRESS_OPS, "ns/op");
+        if (failures > 0) benchFailed = true;
+    }
+}
+
+typedef struct BenchSuite
+{
+    const char *name;
+    void (*run)(uint32_t maxEntities);
+} BenchSuite;
+
+static const BenchSuite benchSuites[] = {
+    { "push", BenchPushThroughput },
+    { "fault", BenchPageFaults },
+    { "reuse", BenchClearReuse },
+    { "overhead", BenchMemoryOverhead },
+    { "hugepages", BenchHugePages },
+    { "commit", BenchCommitPolicy },
+    { "concurrent", BenchConcurrentPush },
+    { "pool", BenchPoolChurn },
+    { "chained", BenchChainedBlocks },
+    { "snapshot", BenchSnapshot },
+    { "dynarray", BenchDynamicArray },
+    { "stress", BenchStress },
+};
+
+int main(int argc, char **argv)
+{
+    uint32_t maxEntities = DEFAULT_ENTITIES;
+    const char *onlySuite = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--csv") == 0) benchFormat = BENCH_FORMAT_CSV;
+        else if (strcmp(argv[i], "--json") == 0) benchFormat = BENCH_FORMAT_JSON;
+        else if (strcmp(argv[i], "--suite") == 0 && i + 1 < argc) onlySuite = argv[++i];
+        else maxEntities = (uint32_t)strtoul(argv[i], NULL, 10);
+    }
+    if (maxEntities == 0) maxEntities = DEFAULT_ENTITIES;
+
+    if (benchFormat == BENCH_FORMAT_CSV) printf("suite,name,param,value,unit\n");
+    if (benchFormat == BENCH_FORMAT_JSON) printf("{\n  \"benchmark\": \"arena_bench\",\n  \"maxEntities\": %u,\n  \"results\": [\n", maxEntities);
+
+    bool ran = false;
+    for (uint32_t i = 0; i < sizeof(benchSuites) / sizeof(benchSuites[0]); i++)
+    {
+        if (onlySuite != NULL && strcmp(onlySuite, benchSuites[i].name) != 0) continue;
+        benchSuites[i].run(maxEntities);
+        ran = true;
+    }
+
+    if (benchFormat == BENCH_FORMAT_JSON) printf("\n  ]\n}\n");
+
+    if (!ran)
+    {
+        fprintf(stderr, "no suite called %s\n", onlySuite);
+        return 1;
+    }
+
+    return benchFailed ? 1 : 0;
+}
@@ -0,0 +1,923 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdalign.h>
+#include <math.h>
+#include "../include/arena.h"
+#include "../include/platform.h"
+#include "../include/ecs.h"
+#include "../include/archetype.h"
+#include "../include/jobs.h"
+
+// Headless ECS benchmarks, each one prints one line per measured configuration
+//
+// Usage - ecs_bench [--suite name] [maxEntities]
+
+#define DEFAULT_ENTITIES 65536
+#define BENCH_MAX_COMPONENTS 8
+#define IMAGE_PATH "ecs_bench_world.img"
+#define IMAGE_LOADS 20
+#define ITERATION_SWEEPS 200
+#define MIGRATION_ROUNDS 4
+#define INIT_ROUNDS 5
+#define INIT_FIRST_ENTITIES 1024
+#define COMMAND_ROUNDS 4
+#define PARALLEL_SWEEPS 20
+#define PARALLEL_MAX_THREADS 16
+#define PARALLEL_CHUNK 4096
+#define CHANGE_SWEEPS 100
+
+// Stand-ins for the game's components, without pulling in raylib
+typedef struct BenchPosition
+{
+    float x;
+    float y;
+} BenchPosition;
+
+typedef struct BenchPositionSet
+{
+    BenchPosition *set;
+    uint32_t id;
+} BenchPositionSet;
+
+typedef struct BenchVelocity
+{
+    float x;
+    float y;
+} BenchVelocity;
+
+typedef struct BenchVelocitySet
+{
+    BenchVelocity *set;
+    uint32_t id;
+} BenchVelocitySet;
+
+typedef struct BenchMass
+{
+    float inverse;
+} BenchMass;
+
+typedef struct BenchMassSet
+{
+    BenchMass *set;
+    uint32_t id;
+} BenchMassSet;
+
+typedef struct BenchRect
+{
+    float x;
+    float y;
+    float width;
+    float height;
+} BenchRect;
+
+typedef struct BenchRectSet
+{
+    BenchRect *set;
+    uint32_t id;
+} BenchRectSet;
+
+static void BenchReport(const char *suite, const char *name, uint64_t param, double value, const char *unit)
+{
+    printf("%-12s %-40s %10llu %14.3f %s\n", suite, name, (unsigned long long)param, value, unit);
+}
+
+// Builds an ECS with every entity holding a position and every other one a velocity,
+// all in the one arena so the world can be saved as an image
+//
+// Return - The ECS, NULL on failure
+static ECS *BuildWorld(Arena *arena, uint32_t maxEntities, BenchPositionSet *positions, BenchVelocitySet *velocities)
+{
+    ECS *ecs = PushStruct(arena, ECS);
+    if (ecs == NULL || !ECSInit(ecs, arena, maxEntities, BENCH_MAX_COMPONENTS)) return NULL;
+
+    RegisterComponent(ecs, arena, (*positions), BenchPosition);
+    RegisterComponent(ecs, arena, (*velocities), BenchVelocity);
+    if (positions->set == NULL || velocities->set == NULL) return NULL;
+
+    for (uint32_t i = 0; i < maxEntities; i++)
+    {
+        uint32_t entity = CreateEntity(ecs);
+        AddComponent(entity, (*positions), ecs, ((BenchPosition){ (float)i, 0.0f }));
+        if (i % 2 == 0) AddComponent(entity, (*velocities), ecs, ((BenchVelocity){ 1.0f, 1.0f }));
+    }
+
+    return ecs;
+}
+
+// Moves every entity with a velocity, touching the sparse maps like the game's systems do
+static float MoveSystem(ECS *ecs, BenchPositionSet positions, BenchVelocitySet velocities)
+{
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < ECSComponents(ecs)[velocities.id].size; i++)
+    {
+        uint32_t entity = GetEntityID(ecs, i, velocities.id);
+        BenchPosition *position = &positions.set[GetEntityIndex(ecs, entity, positions.id)];
+        position->x += velocities.set[i].x;
+        position->y += velocities.set[i].y;
+        sum += position->x;
+    }
+
+    return sum;
+}
+
+// Building a world from scratch vs mapping a saved image of it back in
+static void BenchImageLoad(uint32_t maxEntities)
+{
+    Arena *arena = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 32 });
+    if (arena == NULL)
+    {
+        fprintf(stderr, "image: could not reserve arena\n");
+        return;
+    }
+
+    BenchPositionSet positions;
+    BenchVelocitySet velocities;
+    uint64_t start = PlatformTimeNs();
+    ECS *ecs = BuildWorld(arena, maxEntities, &positions, &velocities);
+    uint64_t end = PlatformTimeNs();
+    if (ecs == NULL)
+    {
+        fprintf(stderr, "image: could not build world\n");
+        ArenaDealloc(arena);
+        return;
+    }
+    BenchReport("image", "build", maxEntities, (double)(end - start) / 1000.0, "us");
+
+    start = PlatformTimeNs();
+    bool saved = ArenaSaveImage(arena, IMAGE_PATH, ecs);
+    end = PlatformTimeNs();
+    ArenaDealloc(arena);
+    if (!saved)
+    {
+        fprintf(stderr, "image: could not save %s\n", IMAGE_PATH);
+        return;
+    }
+    BenchReport("image", "save", maxEntities, (double)(end - start) / 1000.0, "us");
+
+    uint64_t loadTime = 0;
+    uint64_t firstSweepTime = 0;
+    volatile float sink = 0.0f;
+    for (int r = 0; r < IMAGE_LOADS; r++)
+    {
+        start = PlatformTimeNs();
+        void *root;
+        Arena *loaded = ArenaLoadImage(IMAGE_PATH, 0, &root);
+        if (loaded == NULL)
+        {
+            fprintf(stderr, "image: could not load %s\n", IMAGE_PATH);
+            break;
+        }
+        ECS *loadedECS = root;
+        ECSBindArena(loadedECS, loaded);
+        BindComponent(loadedECS, positions, 0);
+        BindComponent(loadedECS, velocities, 1);
+        end = PlatformTimeNs();
+        loadTime += end - start;
+
+        // Pages are only read in once touched, so the first sweep pays for what loading skipped
+        start = PlatformTimeNs();
+        sink += MoveSystem(loadedECS, positions, velocities);
+        end = PlatformTimeNs();
+        firstSweepTime += end - start;
+
+        ArenaDealloc(loaded);
+    }
+    (void)sink;
+
+    BenchReport("image", "load", maxEntities, (double)loadTime / (IMAGE_LOADS * 1000.0), "us");
+    BenchReport("image", "first_sweep_after_load", maxEntities, (double)firstSweepTime / (IMAGE_LOADS * 1000.0), "us");
+
+    remove(IMAGE_PATH);
+}
+
+// Damps the velocity of every entity with a mass, the sparse sets need a lookup per extra component
+static float DampSystem(ECS *ecs, BenchPositionSet positions, BenchVelocitySet velocities, BenchMassSet masses)
+{
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < ECSComponents(ecs)[masses.id].size; i++)
+    {
+        uint32_t entity = GetEntityID(ecs, i, masses.id);
+        uint32_t velocityIndex = GetEntityIndex(ecs, entity, velocities.id);
+        if (velocityIndex == UINT32_MAX) continue;
+
+        BenchVelocity *velocity = &velocities.set[velocityIndex];
+        BenchPosition *position = &positions.set[GetEntityIndex(ecs, entity, positions.id)];
+        velocity->x *= 1.0f - 0.01f * masses.set[i].inverse;
+        velocity->y *= 1.0f - 0.01f * masses.set[i].inverse;
+        position->x += velocity->x;
+        sum += position->x;
+    }
+
+    return sum;
+}
+
+// DampSystem the way the game's systems were written before queries, checking signatures bit by bit
+static float DampSystemBitTest(ECS *ecs, BenchPositionSet positions, BenchVelocitySet velocities, BenchMassSet masses)
+{
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < ECSComponents(ecs)[masses.id].size; i++)
+    {
+        uint32_t entity = GetEntityID(ecs, i, masses.id);
+        uint64_t *signature = GetEntitySignature(ecs, entity);
+        if (!BITTEST(signature, velocities.id)) continue;
+        if (!BITTEST(signature, positions.id)) continue;
+
+        BenchVelocity *velocity = &velocities.set[GetEntityIndex(ecs, entity, velocities.id)];
+        BenchPosition *position = &positions.set[GetEntityIndex(ecs, entity, positions.id)];
+        velocity->x *= 1.0f - 0.01f * masses.set[i].inverse;
+        velocity->y *= 1.0f - 0.01f * masses.set[i].inverse;
+        position->x += velocity->x;
+        sum += position->x;
+    }
+
+    return sum;
+}
+
+static float DampSystemQuery(ECS *ecs, BenchPositionSet positions, BenchVelocitySet velocities, BenchMassSet masses)
+{
+    float sum = 0.0f;
+    ECSQuery query = ECSQueryBegin(ecs, ECSComponentList(positions.id, velocities.id, masses.id), NULL, 0);
+    while (ECSQueryNext(&query))
+    {
+        BenchPosition *position = ECSQueryComponent(&query, BenchPosition, 0);
+        BenchVelocity *velocity = ECSQueryComponent(&query, BenchVelocity, 1);
+        BenchMass *mass = ECSQueryComponent(&query, BenchMass, 2);
+        velocity->x *= 1.0f - 0.01f * mass->inverse;
+        velocity->y *= 1.0f - 0.01f * mass->inverse;
+        position->x += velocity->x;
+        sum += position->x;
+    }
+
+    return sum;
+}
+
+static float ArchetypeMoveSystem(ArchetypeStore *store, uint32_t positionID, uint32_t velocityID)
+{
+    float sum = 0.0f;
+    ArchetypeQuery query = ArchetypeQueryBegin(store, ArchetypeBit(positionID) | ArchetypeBit(velocityID), 0);
+    while (ArchetypeQueryNext(&query))
+    {
+        BenchPosition *position = ArchetypeQueryColumn(&query, BenchPosition, positionID);
+        BenchVelocity *velocity = ArchetypeQueryColumn(&query, BenchVelocity, velocityID);
+        for (uint32_t i = 0; i < query.count; i++)
+        {
+            position[i].x += velocity[i].x;
+            position[i].y += velocity[i].y;
+            sum += position[i].x;
+        }
+    }
+
+    return sum;
+}
+
+static float ArchetypeDampSystem(ArchetypeStore *store, uint32_t positionID, uint32_t velocityID, uint32_t massID)
+{
+    float sum = 0.0f;
+    ArchetypeMask required = ArchetypeBit(positionID) | ArchetypeBit(velocityID) | ArchetypeBit(massID);
+    ArchetypeQuery query = ArchetypeQueryBegin(store, required, 0);
+    while (ArchetypeQueryNext(&query))
+    {
+        BenchPosition *position = ArchetypeQueryColumn(&query, BenchPosition, positionID);
+        BenchVelocity *velocity = ArchetypeQueryColumn(&query, BenchVelocity, velocityID);
+        BenchMass *mass = ArchetypeQueryColumn(&query, BenchMass, massID);
+        for (uint32_t i = 0; i < query.count; i++)
+        {
+            velocity[i].x *= 1.0f - 0.01f * mass[i].inverse;
+            velocity[i].y *= 1.0f - 0.01f * mass[i].inverse;
+            position[i].x += velocity[i].x;
+            sum += position[i].x;
+        }
+    }
+
+    return sum;
+}
+
+// Times sweeps of a system, reported per entity the system matches
+#define BenchSweeps(suite, name, matched, call) {\
+    volatile float sink = 0.0f;\
+    uint64_t start = PlatformTimeNs();\
+    for (int r = 0; r < ITERATION_SWEEPS; r++) sink += (call);\
+    uint64_t end = PlatformTimeNs();\
+    (void)sink;\
+    BenchReport(suite, name, maxEntities, (double)(end - start) / ((double)ITERATION_SWEEPS * (matched)), "ns/entity");\
+}
+
+// The same world, every entity with a position, every other one a velocity and every third one a mass,
+// swept by 2 and 3 component systems out of the sparse sets and out of archetype chunks
+static void BenchIteration(uint32_t maxEntities)
+{
+    Arena *sparseArena = ArenaAlloc();
+    Arena *archetypeArena = ArenaAlloc();
+    if (sparseArena == NULL || archetypeArena == NULL)
+    {
+        fprintf(stderr, "iteration: could not reserve arenas\n");
+        ArenaDealloc(sparseArena);
+        ArenaDealloc(archetypeArena);
+        return;
+    }
+
+    BenchPositionSet positions;
+    BenchVelocitySet velocities;
+    BenchMassSet masses;
+    ECS *ecs = BuildWorld(sparseArena, maxEntities, &positions, &velocities);
+    if (ecs != NULL) RegisterComponent(ecs, sparseArena, masses, BenchMass);
+
+    ArchetypeStore store;
+    bool built = ecs != NULL && masses.set != NULL && ArchetypeStoreInit(&store, archetypeArena, maxEntities);
+    uint32_t positionID = built ? ArchetypeRegister(&store, BenchPosition) : ARCHETYPE_NONE;
+    uint32_t velocityID = built ? ArchetypeRegister(&store, BenchVelocity) : ARCHETYPE_NONE;
+    uint32_t massID = built ? ArchetypeRegister(&store, BenchMass) : ARCHETYPE_NONE;
+    built = built && positionID != ARCHETYPE_NONE && velocityID != ARCHETYPE_NONE && massID != ARCHETYPE_NONE;
+
+    uint32_t moving = 0;
+    uint32_t damped = 0;
+    for (uint32_t i = 0; built && i < maxEntities; i++)
+    {
+        BenchPosition position = { (float)i, 0.0f };
+        BenchVelocity velocity = { 1.0f, 1.0f };
+        BenchMass mass = { 0.5f };
+
+        built = ArchetypeAddComponent(&store, i, positionID, &position);
+        if (i % 2 == 0)
+        {
+            built = built && ArchetypeAddComponent(&store, i, velocityID, &velocity);
+            moving++;
+        }
+        if (i % 3 == 0)
+        {
+            AddComponent(i, masses, ecs, mass);
+            built = built && ArchetypeAddComponent(&store, i, massID, &mass);
+            if (i % 2 == 0) damped++;
+        }
+    }
+
+    if (!built)
+    {
+        fprintf(stderr, "iteration: could not build worlds\n");
+        ArenaDealloc(sparseArena);
+        ArenaDealloc(archetypeArena);
+        return;
+    }
+
+    BenchSweeps("iteration", "sparse_2_components", moving, MoveSystem(ecs, positions, velocities));
+    BenchSweeps("iteration", "archetype_2_components", moving, ArchetypeMoveSystem(&store, positionID, velocityID));
+    BenchSweeps("iteration", "sparse_3_components", damped, DampSystem(ecs, positions, velocities, masses));
+    BenchSweeps("iteration", "archetype_3_components", damped, ArchetypeDampSystem(&store, positionID, velocityID, massID));
+
+    // Adding and removing a component moves the entity between archetypes, which the sparse sets never pay for
+    uint64_t start = PlatformTimeNs();
+    for (int r = 0; r < MIGRATION_ROUNDS; r++)
+    {
+        for (uint32_t i = 1; i < maxEntities; i += 2) ArchetypeAddComponent(&store, i, velocityID, NULL);
+        for (uint32_t i = 1; i < maxEntities; i += 2) ArchetypeRemoveComponent(&store, i, velocityID);
+    }
+    uint64_t end = PlatformTimeNs();
+    BenchReport("iteration", "archetype_add_remove", maxEntities,
+                (double)(end - start) / ((double)MIGRATION_ROUNDS * maxEntities), "ns/op");
+
+    start = PlatformTimeNs();
+    for (int r = 0; r < MIGRATION_ROUNDS; r++)
+    {
+        for (uint32_t i = 1; i < maxEntities; i += 2) AddComponent(i, velocities, ecs, ((BenchVelocity){ 0.0f, 0.0f }));
+        for (uint32_t i = 1; i < maxEntities; i += 2) RemoveComponent(velocities, ecs, i);
+    }
+    end = PlatformTimeNs();
+    BenchReport("iteration", "sparse_add_remove", maxEntities,
+                (double)(end - start) / ((double)MIGRATION_ROUNDS * maxEntities), "ns/op");
+
+    ArenaDealloc(sparseArena);
+    ArenaDealloc(archetypeArena);
+}
+
+// A 3 component system written by hand against the sparse sets vs with ECSQuery,
+// in a world where the mass array is the smallest and drives the query
+static void BenchQuery(uint32_t maxEntities)
+{
+    Arena *arena = ArenaAlloc();
+    BenchPositionSet positions;
+    BenchVelocitySet velocities;
+    BenchMassSet masses;
+    ECS *ecs = (arena != NULL) ? BuildWorld(arena, maxEntities, &positions, &velocities) : NULL;
+    if (ecs != NULL) RegisterComponent(ecs, arena, masses, BenchMass);
+    if (ecs == NULL || masses.set == NULL)
+    {
+        fprintf(stderr, "query: could not build world\n");
+        ArenaDealloc(arena);
+        return;
+    }
+
+    uint32_t damped = 0;
+    for (uint32_t i = 0; i < maxEntities; i += 3)
+    {
+        AddComponent(i, masses, ecs, ((BenchMass){ 0.5f }));
+        if (i % 2 == 0) damped++;
+    }
+
+    BenchSweeps("query", "bittest_3_components", damped, DampSystemBitTest(ecs, positions, velocities, masses));
+    BenchSweeps("query", "ecsquery_3_components", damped, DampSystemQuery(ecs, positions, velocities, masses));
+
+    ArenaDealloc(arena);
+}
+
+// Scalar BITTEST check per entity vs ECSMatchSignatures, over every entity ID and over a component's
+// dense entity list (the way queries call it), with the signatures of the iteration world
+static void BenchSignatures(uint32_t maxEntities)
+{
+    Arena *arena = ArenaAlloc();
+    BenchPositionSet positions;
+    BenchVelocitySet velocities;
+    ECS *ecs = (arena != NULL) ? BuildWorld(arena, maxEntities, &positions, &velocities) : NULL;
+    uint32_t *matches = (ecs != NULL) ? PushArray(arena, uint32_t, maxEntities) : NULL;
+    if (matches == NULL)
+    {
+        fprintf(stderr, "signatures: could not build world\n");
+        ArenaDealloc(arena);
+        return;
+    }
+
+    uint64_t *signatures = GetEntitySignature(ecs, 0);
+    uint32_t words = ecs->entities.signatureWords;
+    uint64_t required[ECS_SIGNATURE_MAX_WORDS] = { 0 };
+    uint64_t excluded[ECS_SIGNATURE_MAX_WORDS] = { 0 };
+    BITSET(required, positions.id);
+    BITSET(required, velocities.id);
+
+    volatile uint32_t sink = 0;
+    uint64_t start = PlatformTimeNs();
+    for (int r = 0; r < ITERATION_SWEEPS; r++)
+    {
+        uint32_t matchCount = 0;
+        for (uint32_t i = 0; i < maxEntities; i++)
+        {
+            uint64_t *signature = &signatures[(uint64_t)i * words];
+            matches[matchCount] = i;
+            matchCount += BITTEST(signature, positions.id) && BITTEST(signature, velocities.id);
+        }
+        sink += matchCount;
+    }
+    uint64_t end = PlatformTimeNs();
+    BenchReport("signatures", "bittest_all_ids", maxEntities, (double)(end - start) / ((double)ITERATION_SWEEPS * maxEntities), "ns/entity");
+
+    start = PlatformTimeNs();
+    for (int r = 0; r < ITERATION_SWEEPS; r++)
+    {
+        sink += ECSMatchSignatures(signatures, words, required, excluded, NULL, maxEntities, matches);
+    }
+    end = PlatformTimeNs();
+    BenchReport("signatures", "batch_all_ids", maxEntities, (double)(end - start) / ((double)ITERATION_SWEEPS * maxEntities), "ns/entity");
+
+    uint32_t *positionEntities = ArenaRelPtr(uint32_t, ECSComponents(ecs)[positions.id].indexToEntity);
+    start = PlatformTimeNs();
+    for (int r = 0; r < ITERATION_SWEEPS; r++)
+    {
+        sink += ECSMatchSignatures(signatures, words, required, excluded, positionEntities, maxEntities, matches);
+    }
+    end = PlatformTimeNs();
+    BenchReport("signatures", "batch_entity_list", maxEntities, (double)(end - start) / ((double)ITERATION_SWEEPS * maxEntities), "ns/entity");
+    (void)sink;
+
+    ArenaDealloc(arena);
+}
+
+// The query world filtered for position AND velocity AND NOT mass: one ECSCombineBitPlanes call over
+// every entity ID against one ECSMatchSignatures call, then the 3 component query on both backends
+static void BenchBitPlanes(uint32_t maxEntities)
+{
+    Arena *arena = ArenaAlloc();
+    BenchPositionSet positions;
+    BenchVelocitySet velocities;
+    BenchMassSet masses;
+    ECS *ecs = (arena != NULL) ? BuildWorld(arena, maxEntities, &positions, &velocities) : NULL;
+    if (ecs != NULL) RegisterComponent(ecs, arena, masses, BenchMass);
+    uint32_t *matches = (ecs != NULL) ? PushArray(arena, uint32_t, maxEntities) : NULL;
+    uint64_t *combined = (matches != NULL) ? PushArray(arena, uint64_t, ecs->planeWords) : NULL;
+    if (combined == NULL || masses.set == NULL || !ECSSetQueryBackend(ecs, arena, ECS_QUERY_BIT_PLANES))
+    {
+        fprintf(stderr, "bitplanes: could not build world\n");
+        ArenaDealloc(arena);
+        return;
+    }
+
+    uint32_t damped = 0;
+    for (uint32_t i = 0; i < maxEntities; i += 3)
+    {
+        AddComponent(i, masses, ecs, ((BenchMass){ 0.5f }));
+        if (i % 2 == 0) damped++;
+    }
+
+    uint64_t required[ECS_SIGNATURE_MAX_WORDS] = { 0 };
+    uint64_t excluded[ECS_SIGNATURE_MAX_WORDS] = { 0 };
+    BITSET(required, positions.id);
+    BITSET(required, velocities.id);
+    BITSET(excluded, masses.id);
+
+    volatile uint32_t sink = 0;
+    uint64_t start = PlatformTimeNs();
+    for (int r = 0; r < ITERATION_SWEEPS; r++)
+    {
+        sink += ECSMatchSignatures(GetEntitySignature(ecs, 0), ecs->entities.signatureWords, required, excluded, NULL, maxEntities, matches);
+    }
+    uint64_t end = PlatformTimeNs();
+    BenchReport("bitplanes", "signatures_filter", maxEntities, (double)(end - start) / (ITERATION_SWEEPS * 1000.0), "us");
+
+    const uint64_t *requiredPlanes[] = { ECSBitPlane(ecs, positions.id), ECSBitPlane(ecs, velocities.id) };
+    const uint64_t *excludedPlanes[] = { ECSBitPlane(ecs, masses.id) };
+    start = PlatformTimeNs();
+    for (int r = 0; r < ITERATION_SWEEPS; r++)
+    {
+        ECSCombineBitPlanes(requiredPlanes, 2, excludedPlanes, 1, ecs->planeWords, combined);
+        sink += (uint32_t)combined[r % ecs->planeWords];
+    }
+    end = PlatformTimeNs();
+    BenchReport("bitplanes", "planes_filter", maxEntities, (double)(end - start) / (ITERATION_SWEEPS * 1000.0), "us");
+
+    // Turning the combined words into entity IDs, which is what a query does with them
+    start = PlatformTimeNs();
+    for (int r = 0; r < ITERATION_SWEEPS; r++)
+    {
+        uint32_t matchCount = 0;
+        for (uint32_t w = 0; w < ecs->planeWords; w++)
+        {
+            for (uint64_t word = combined[w]; word != 0; word &= word - 1)
+            {
+                matches[matchCount++] = w * ECS_SIGNATURE_WORD_BITS + (uint32_t)__builtin_ctzll(word);
+            }
+        }
+        sink += matchCount;
+    }
+    end = PlatformTimeNs();
+    BenchReport("bitplanes", "planes_bit_scan", maxEntities, (double)(end - start) / (ITERATION_SWEEPS * 1000.0), "us");
+    (void)sink;
+
+    ECSSetQueryBackend(ecs, arena, ECS_QUERY_SPARSE_SETS);
+    BenchSweeps("bitplanes", "sparse_query_3_components", damped, DampSystemQuery(ecs, positions, velocities, masses));
+    ECSSetQueryBackend(ecs, arena, ECS_QUERY_BIT_PLANES);
+    BenchSweeps("bitplanes", "planes_query_3_components", damped, DampSystemQuery(ecs, positions, velocities, masses));
+
+    ArenaDealloc(arena);
+}
+
+// Cost of standing up an empty world and creating its first entities, as the game does on every restart,
+// and how much of the ECS's arena they use. Component data goes on its own arena, like the game's,
+// so only the ECS is counted. Always runs at 64k and the largest maxEntities an ECS allows,
+// whatever maxEntities was asked for
+static void BenchInit(uint32_t maxEntities)
+{
+    (void)maxEntities;
+    const uint32_t sizes[] = { 65536, ENTITY_INDEX_MASK };
+
+    for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        uint64_t initTime = 0;
+        uint64_t firstEntitiesTime = 0;
+        uint64_t residentBytes = 0;
+        uint64_t ecsBytes = 0;
+        for (int r = 0; r < INIT_ROUNDS; r++)
+        {
+            Arena *arena = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 34 });
+            Arena *dataArena = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 34 });
+            if (arena == NULL || dataArena == NULL)
+            {
+                fprintf(stderr, "init: could not reserve arena\n");
+                if (arena != NULL) ArenaDealloc(arena);
+                if (dataArena != NULL) ArenaDealloc(dataArena);
+                return;
+            }
+
+            uint64_t residentBefore = PlatformResidentBytes();
+            uint64_t start = PlatformTimeNs();
+            ECS *ecs = PushStruct(arena, ECS);
+            bool initialized = ecs != NULL && ECSInit(ecs, arena, sizes[s], BENCH_MAX_COMPONENTS);
+            BenchPositionSet positions;
+            if (initialized) RegisterComponent(ecs, dataArena, positions, BenchPosition);
+            uint64_t end = PlatformTimeNs();
+            if (!initialized || positions.set == NULL)
+            {
+                fprintf(stderr, "init: could not initialize ECS\n");
+                ArenaDealloc(arena);
+                ArenaDealloc(dataArena);
+                return;
+            }
+            initTime += end - start;
+
+            start = PlatformTimeNs();
+            for (uint32_t i = 0; i < INIT_FIRST_ENTITIES; i++)
+            {
+                uint32_t entity = CreateEntity(ecs);
+                AddComponent(entity, positions, ecs, ((BenchPosition){ (float)i, 0.0f }));
+            }
+            end = PlatformTimeNs();
+            firstEntitiesTime += end - start;
+
+            uint64_t residentAfter = PlatformResidentBytes();
+            if (residentAfter > residentBefore) residentBytes += residentAfter - residentBefore;
+            ecsBytes += ArenaGetStats(arena).used;
+
+            ArenaDealloc(arena);
+            ArenaDealloc(dataArena);
+        }
+
+        BenchReport("init", "ecs_init", sizes[s], (double)initTime / (INIT_ROUNDS * 1000.0), "us");
+        BenchReport("init", "first_1024_entities", sizes[s], (double)firstEntitiesTime / (INIT_ROUNDS * 1000.0), "us");
+        BenchReport("init", "resident_after_first_entities", sizes[s], (double)residentBytes / (INIT_ROUNDS * 1024.0), "KB");
+        BenchReport("init", "ecs_arena_after_first_entities", sizes[s], (double)ecsBytes / (INIT_ROUNDS * 1024.0), "KB");
+    }
+}
+
+// Spawning and despawning every entity with a position and velocity, one structural change at a time
+// vs recorded in a command buffer and played back in one batch
+static void BenchCommands(uint32_t maxEntities)
+{
+    const char *names[] = { "direct", "command_buffer" };
+
+    for (int deferred = 0; deferred < 2; deferred++)
+    {
+        Arena *arena = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 32 });
+        Arena *commandArena = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 32 });
+        ECS *ecs = (arena != NULL) ? PushStruct(arena, ECS) : NULL;
+        if (ecs == NULL || commandArena == NULL || !ECSInit(ecs, arena, maxEntities, BENCH_MAX_COMPONENTS))
+        {
+            fprintf(stderr, "commands: could not set up ECS\n");
+            if (arena != NULL) ArenaDealloc(arena);
+            if (commandArena != NULL) ArenaDealloc(commandArena);
+            return;
+        }
+
+        BenchPositionSet positions;
+        BenchVelocitySet velocities;
+        RegisterComponent(ecs, arena, positions, BenchPosition);
+        RegisterComponent(ecs, arena, velocities, BenchVelocity);
+
+        ECSCommandBuffer commands;
+        ECSCommandBufferInit(&commands, ecs, commandArena);
+
+        uint64_t spawnTime = 0;
+        uint64_t despawnTime = 0;
+        // Round 0 is a warm up and is not counted, a game reuses the same buffer every frame
+        // so its arena and the ECS's dense arrays have already grown by the time it matters
+        for (int r = 0; r <= COMMAND_ROUNDS; r++)
+        {
+            uint64_t start = PlatformTimeNs();
+            for (uint32_t i = 0; i < maxEntities; i++)
+            {
+                if (deferred)
+                {
+                    uint32_t entity = ECSCommandCreateEntity(&commands);
+                    DeferAddComponent(entity, positions, &commands, ((BenchPosition){ (float)i, 0.0f }));
+                    DeferAddComponent(entity, velocities, &commands, ((BenchVelocity){ 1.0f, 1.0f }));
+                }
+                else
+                {
+                    uint32_t entity = CreateEntity(ecs);
+                    AddComponent(entity, positions, ecs, ((BenchPosition){ (float)i, 0.0f }));
+                    AddComponent(entity, velocities, ecs, ((BenchVelocity){ 1.0f, 1.0f }));
+                }
+            }
+            if (deferred) ECSCommandBufferPlayback(&commands);
+            uint64_t end = PlatformTimeNs();
+            if (r > 0) spawnTime += end - start;
+
+            start = PlatformTimeNs();
+            for (uint32_t i = 0; i < maxEntities; i++)
+            {
+                if (deferred) ECSCommandRemoveEntity(&commands, i);
+                else RemoveEntity(i, ecs);
+            }
+            if (deferred) ECSCommandBufferPlayback(&commands);
+            end = PlatformTimeNs();
+            if (r > 0) despawnTime += end - start;
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "%s_spawn", names[deferred]);
+        BenchReport("commands", name, maxEntities, (double)spawnTime / ((double)COMMAND_ROUNDS * maxEntities), "ns/entity");
+        snprintf(name, sizeof(name), "%s_despawn", names[deferred]);
+        BenchReport("commands", name, maxEntities, (double)despawnTime / ((double)COMMAND_ROUNDS * maxEntities), "ns/entity");
+
+        ArenaDealloc(arena);
+        ArenaDealloc(commandArena);
+    }
+}
+
+// Per-entity work for the parallel suite, a few dependent float operations so it is not only memory bound
+static void IntegrateChunk(ECSQuery *query, void *data)
+{
+    float dt = *(float *)data;
+    while (ECSQueryNext(query))
+    {
+        BenchPosition *position = ECSQueryComponent(query, BenchPosition, 0);
+        BenchVelocity *velocity = ECSQueryComponent(query, BenchVelocity, 1);
+
+        velocity->x = velocity->x * 0.99f + sinf(position->y) * dt;
+        velocity->y = velocity->y * 0.99f + cosf(position->x) * dt;
+        position->x += velocity->x * dt;
+        position->y += velocity->y * dt;
+    }
+}
+
+// One position and velocity query over every other entity, run serially and as chunks on a job system
+// with 1 thread up to every processor. Always runs at 64k and the largest maxEntities an ECS allows (about 1M),
+// whatever maxEntities was asked for
+static void BenchParallel(uint32_t maxEntities)
+{
+    (void)maxEntities;
+    const uint32_t sizes[] = { 65536, ENTITY_INDEX_MASK };
+    float dt = 1.0f / 60.0f;
+
+    for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        uint32_t entities = sizes[s];
+        Arena *arena = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 34 });
+        BenchPositionSet positions;
+        BenchVelocitySet velocities;
+        ECS *ecs = (arena != NULL) ? BuildWorld(arena, entities, &positions, &velocities) : NULL;
+        if (ecs == NULL)
+        {
+            fprintf(stderr, "parallel: could not build world\n");
+            if (arena != NULL) ArenaDealloc(arena);
+            return;
+        }
+        uint32_t matched = ECSComponents(ecs)[velocities.id].size;
+
+        ECSQuery query = ECSQueryBegin(ecs, ECSComponentList(positions.id, velocities.id), NULL, 0);
+        IntegrateChunk(&query, &dt);
+        uint64_t start = PlatformTimeNs();
+        for (int r = 0; r < PARALLEL_SWEEPS; r++)
+        {
+            query = ECSQueryBegin(ecs, ECSComponentList(positions.id, velocities.id), NULL, 0);
+            IntegrateChunk(&query, &dt);
+        }
+        double serial = (double)(PlatformTimeNs() - start) / ((double)PARALLEL_SWEEPS * matched);
+        BenchReport("parallel", "serial_query", entities, serial, "ns/entity");
+
+        uint32_t processors = PlatformProcessorCount();
+        uint32_t maxThreads = (processors < PARALLEL_MAX_THREADS) ? processors : PARALLEL_MAX_THREADS;
+        for (uint32_t threads = 1; threads <= maxThreads; threads = (threads < maxThreads && threads * 2 > maxThreads) ? maxThreads : threads * 2)
+        {
+            static JobSystem jobs;
+            ArenaTemp jobsStart = ArenaTempBegin(arena);
+            if (!JobSystemInit(&jobs, arena, threads - 1))
+            {
+                fprintf(stderr, "parallel: could not start %u threads\n", threads);
+                break;
+            }
+
+            query = ECSQueryBegin(ecs, ECSComponentList(positions.id, velocities.id), NULL, 0);
+            ECSParallelForEach(&jobs, &query, PARALLEL_CHUNK, IntegrateChunk, &dt);
+            start = PlatformTimeNs();
+            for (int r = 0; r < PARALLEL_SWEEPS; r++)
+            {
+                query = ECSQueryBegin(ecs, ECSComponentList(positions.id, velocities.id), NULL, 0);
+                ECSParallelForEach(&jobs, &query, PARALLEL_CHUNK, IntegrateChunk, &dt);
+            }
+            double parallel = (double)(PlatformTimeNs() - start) / ((double)PARALLEL_SWEEPS * matched);
+
+            char name[64];
+            snprintf(name, sizeof(name), "threads_%u_parallel_for", threads);
+            BenchReport("parallel", name, entities, parallel, "ns/entity");
+            snprintf(name, sizeof(name), "threads_%u_speedup", threads);
+            BenchReport("parallel", name, entities, serial / parallel, "x");
+
+            JobSystemRelease(&jobs);
+            ArenaTempEnd(jobsStart);
+        }
+
+        ArenaDealloc(arena);
+    }
+}
+
+// Copies positions into rects like the game's transform sync, only for positions changed since since
+static float SyncRects(ECS *ecs, BenchRectSet rects, BenchPositionSet positions, uint32_t since)
+{
+    float sum = 0.0f;
+    ECSQuery query = ECSQueryBegin(ecs, ECSComponentList(rects.id, positions.id), NULL, 0);
+    ECSQueryChangedSince(&query, 1, since);
+    while (ECSQueryNext(&query))
+    {
+        BenchRect *rect = ECSQueryComponentMut(&query, BenchRect, 0);
+        BenchPosition *position = ECSQueryComponent(&query, BenchPosition, 1);
+        rect->x = position->x;
+        rect->y = position->y;
+        sum += rect->x;
+    }
+
+    return sum;
+}
+
+// Moving every entity with a velocity, writing positions with and without stamping their change ticks
+static float MoveSystemQuery(ECS *ecs, BenchPositionSet positions, BenchVelocitySet velocities, bool stamp)
+{
+    float sum = 0.0f;
+    ECSQuery query = ECSQueryBegin(ecs, ECSComponentList(positions.id, velocities.id), NULL, 0);
+    while (ECSQueryNext(&query))
+    {
+        BenchPosition *position = stamp ? ECSQueryComponentMut(&query, BenchPosition, 0) : ECSQueryComponent(&query, BenchPosition, 0);
+        BenchVelocity *velocity = ECSQueryComponent(&query, BenchVelocity, 1);
+        position->x += velocity->x;
+        position->y += velocity->y;
+        sum += position->x;
+    }
+
+    return sum;
+}
+
+// Syncing rects to positions for every entity vs only the ones whose position changed since the last sync,
+// with 0%, 1%, 10% and 100% of the positions written each frame, and what stamping costs a writing system
+static void BenchChanges(uint32_t maxEntities)
+{
+    Arena *arena = ArenaAlloc();
+    BenchPositionSet positions;
+    BenchVelocitySet velocities;
+    BenchRectSet rects;
+    ECS *ecs = (arena != NULL) ? BuildWorld(arena, maxEntities, &positions, &velocities) : NULL;
+    if (ecs != NULL) RegisterComponent(ecs, arena, rects, BenchRect);
+    if (ecs == NULL || rects.set == NULL)
+    {
+        fprintf(stderr, "changes: could not build world\n");
+        if (arena != NULL) ArenaDealloc(arena);
+        return;
+    }
+    for (uint32_t i = 0; i < maxEntities; i++) AddComponent(i, rects, ecs, ((BenchRect){ 0.0f, 0.0f, 8.0f, 8.0f }));
+
+    BenchSweeps("changes", "full_sync", maxEntities, SyncRects(ecs, rects, positions, 0));
+
+    const uint32_t percents[] = { 0, 1, 10, 100 };
+    for (uint32_t p = 0; p < sizeof(percents) / sizeof(percents[0]); p++)
+    {
+        // Every entity is written at most once a frame, spread over the whole ID range
+        uint32_t step = (percents[p] == 0) ? 0 : 100 / percents[p];
+        uint32_t lastSync = ECSAdvanceTick(ecs);
+        uint64_t syncTime = 0;
+        volatile float sink = 0.0f;
+        for (int r = 0; r < CHANGE_SWEEPS; r++)
+        {
+            for (uint32_t i = r % 100; step != 0 && i < maxEntities; i += step) GetComponentMut(ecs, positions, i)->x += 1.0f;
+
+            uint64_t start = PlatformTimeNs();
+            uint32_t since = lastSync;
+            lastSync = ECSAdvanceTick(ecs);
+            sink += SyncRects(ecs, rects, positions, since);
+            syncTime += PlatformTimeNs() - start;
+        }
+        (void)sink;
+
+        char name[64];
+        snprintf(name, sizeof(name), "changed_sync_%u_percent", percents[p]);
+        BenchReport("changes", name, maxEntities, (double)syncTime / ((double)CHANGE_SWEEPS * maxEntities), "ns/entity");
+    }
+
+    uint32_t moving = ECSComponents(ecs)[velocities.id].size;
+    BenchSweeps("changes", "move_unstamped", moving, MoveSystemQuery(ecs, positions, velocities, false));
+    BenchSweeps("changes", "move_stamped", moving, MoveSystemQuery(ecs, positions, velocities, true));
+
+    ArenaDealloc(arena);
+}
+
+typedef struct BenchSuite
+{
+    const char *name;
+    void (*run)(uint32_t maxEntities);
+} BenchSuite;
+
+static const BenchSuite benchSuites[] = {
+    { "image", BenchImageLoad },
+    { "iteration", BenchIteration },
+    { "query", BenchQuery },
+    { "signatures", BenchSignatures },
+    { "bitplanes", BenchBitPlanes },
+    { "init", BenchInit },
+    { "commands", BenchCommands },
+    { "parallel", BenchParallel },
+    { "changes", BenchChanges },
+};
+
+int main(int argc, char **argv)
+{
+    uint32_t maxEntities = DEFAULT_ENTITIES;
+    const char *onlySuite = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--suite") == 0 && i + 1 < argc) onlySuite = argv[++i];
+        else maxEntities = (uint32_t)strtoul(argv[i], NULL, 10);
+    }
+    if (maxEntities == 0) maxEntities = DEFAULT_ENTITIES;
+
+    bool ran = false;
+    for (uint32_t i = 0; i < sizeof(benchSuites) / sizeof(benchSuites[0]); i++)
+    {
+        if (onlySuite != NULL && strcmp(onlySuite, benchSuites[i].name) != 0) continue;
+        benchSuites[i].run(maxEntities);
+        ran = true;
+    }
+
+    if (!ran)
+    {
+        fprintf(stderr, "no suite called %s\n", onlySuite);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "../include/arena.h"
+#include "../include/platform.h"
+#include "../include/ecs.h"
+#include "../include/scheduler.h"
+#include "../include/jobs.h"
+
+// Headless scheduler benchmark, runs a synthetic tick of BENCH_SYSTEMS systems
+// on 1 thread up to every processor and prints one line per measured configuration
+//
+// Usage - sched_bench [maxEntities]
+
+#define DEFAULT_ENTITIES 65536
+#define BENCH_SYSTEMS 20
+// Every lane is a chain of systems writing the same component, lanes do not conflict with each other,
+// so at most BENCH_LANES systems can run at once and a tick is BENCH_SYSTEMS / BENCH_LANES systems deep
+#define BENCH_LANES 5
+#define BENCH_SHARED 3
+#define BENCH_MAX_COMPONENTS (BENCH_LANES + BENCH_SHARED)
+#define BENCH_MAX_THREADS 16
+#define BENCH_WARMUP_TICKS 5
+#define BENCH_TICKS 50
+
+typedef struct BenchValue
+{
+    float v[4];
+} BenchValue;
+
+typedef struct BenchValueSet
+{
+    BenchValue *set;
+    uint32_t id;
+} BenchValueSet;
+
+typedef struct BenchSystem
+{
+    ECS *ecs;
+    BenchValueSet written;
+    BenchValueSet read;
+} BenchSystem;
+
+static void BenchReport(const char *suite, const char *name, uint64_t param, double value, const char *unit)
+{
+    printf("%-12s %-40s %10llu %14.3f %s\n", suite, name, (unsigned long long)param, value, unit);
+}
+
+// Stand-in for a system's per-entity work, a few dependent float operations on two components
+static void BenchSystemRun(void *context)
+{
+    BenchSystem *system = context;
+    ECSQuery query = ECSQueryBegin(system->ecs, ECSComponentList(system->written.id, system->read.id), NULL, 0);
+    while (ECSQueryNext(&query))
+    {
+        BenchValue *written = ECSQueryComponent(&query, BenchValue, 0);
+        BenchValue *read = ECSQueryComponent(&query, BenchValue, 1);
+        for (int i = 0; i < 4; i++)
+        {
+            float x = written->v[i] * 0.99f + read->v[i] * 0.01f;
+            written->v[i] = sqrtf(x * x + 1.0f) - 1.0f;
+        }
+    }
+}
+
+static uint64_t RunTicks(Scheduler *scheduler, uint32_t ticks)
+{
+    uint64_t start = PlatformTimeNs();
+    for (uint32_t t = 0; t < ticks; t++) SchedulerRun(scheduler);
+    return PlatformTimeNs() - start;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t maxEntities = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 10) : DEFAULT_ENTITIES;
+    if (maxEntities == 0) maxEntities = DEFAULT_ENTITIES;
+
+    Arena *arena = ArenaAllocParams((ArenaParams){ .reserveSize = 1ULL << 32 });
+    ECS *ecs = (arena != NULL) ? PushStruct(arena, ECS) : NULL;
+    if (ecs == NULL || !ECSInit(ecs, arena, maxEntities, BENCH_MAX_COMPONENTS))
+    {
+        fprintf(stderr, "sched_bench: could not set up ECS\n");
+        if (arena != NULL) ArenaDealloc(arena);
+        return 1;
+    }
+
+    BenchValueSet components[BENCH_MAX_COMPONENTS];
+    for (uint32_t c = 0; c < BENCH_MAX_COMPONENTS; c++) RegisterComponent(ecs, arena, components[c], BenchValue);
+    for (uint32_t i = 0; i < maxEntities; i++)
+    {
+        uint32_t entity = CreateEntity(ecs);
+        for (uint32_t c = 0; c < BENCH_MAX_COMPONENTS; c++) AddComponent(entity, components[c], ecs, ((BenchValue){ { (float)i, 1.0f, 2.0f, 3.0f } }));
+    }
+
+    BenchSystem systems[BENCH_SYSTEMS];
+    for (uint32_t s = 0; s < BENCH_SYSTEMS; s++)
+    {
+        systems[s].ecs = ecs;
+        systems[s].written = components[s % BENCH_LANES];
+        systems[s].read = components[BENCH_LANES + s % BENCH_SHARED];
+    }
+
+    // Ticks with every system called in order, to see what the scheduler itself costs on one thread
+    for (uint32_t s = 0; s < BENCH_SYSTEMS; s++) BenchSystemRun(&systems[s]);
+    uint64_t start = PlatformTimeNs();
+    for (uint32_t t = 0; t < BENCH_TICKS; t++)
+    {
+        for (uint32_t s = 0; s < BENCH_SYSTEMS; s++) BenchSystemRun(&systems[s]);
+    }
+    double serialTick = (double)(PlatformTimeNs() - start) / BENCH_TICKS;
+    BenchReport("scheduler", "serial_calls_tick", maxEntities, serialTick / 1000.0, "us/tick");
+
+    uint32_t processors = PlatformProcessorCount();
+    uint32_t maxThreads = (processors < BENCH_MAX_THREADS) ? processors : BENCH_MAX_THREADS;
+    double oneThreadTick = 0.0;
+    // Powers of two, then every processor if that is not one
+    for (uint32_t threads = 1; threads <= maxThreads; threads = (threads < maxThreads && threads * 2 > maxThreads) ? maxThreads : threads * 2)
+    {
+        static Scheduler scheduler;
+        static JobSystem jobs;
+        ArenaTemp jobsStart = ArenaTempBegin(arena);
+        if (!JobSystemInit(&jobs, arena, threads - 1))
+        {
+            fprintf(stderr, "sched_bench: could not start %u threads\n", threads);
+            break;
+        }
+        SchedulerInit(&scheduler, &jobs);
+
+        for (uint32_t s = 0; s < BENCH_SYSTEMS; s++)
+        {
+            SystemAccess access = { 0 };
+            SystemWrites(access, systems[s].written);
+            SystemReads(access, systems[s].read);
+            SchedulerAddSystem(&scheduler, "bench", BenchSystemRun, &systems[s], access);
+        }
+
+        RunTicks(&scheduler, BENCH_WARMUP_TICKS);
+        double tick = (double)RunTicks(&scheduler, BENCH_TICKS) / BENCH_TICKS;
+        if (threads == 1) oneThreadTick = tick;
+
+        char name[64];
+        snprintf(name, sizeof(name), "threads_%u_tick", threads);
+        BenchReport("scheduler", name, maxEntities, tick / 1000.0, "us/tick");
+        snprintf(name, sizeof(name), "threads_%u_speedup", threads);
+        BenchReport("scheduler", name, maxEntities, oneThreadTick / tick, "x");
+
+        // From the last tick, work over critical path is the most any number of threads could speed it up by
+        snprintf(name, sizeof(name), "threads_%u_critical_path", threads);
+        BenchReport("scheduler", name, maxEntities, (double)scheduler.criticalPathNs / 1000.0, "us");
+        snprintf(name, sizeof(name), "threads_%u_critical_path_systems", threads);
+        BenchReport("scheduler", name, maxEntities, (double)scheduler.criticalPathCount, "systems");
+        snprintf(name, sizeof(name), "threads_%u_parallelism", threads);
+        BenchReport("scheduler", name, maxEntities, (double)scheduler.workNs / (double)scheduler.criticalPathNs, "x");
+
+        JobSystemRelease(&jobs);
+        ArenaTempEnd(jobsStart);
+    }
+
+    ArenaDealloc(arena);
+
+    return 0;
+}
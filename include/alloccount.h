@@ -0,0 +1,25 @@
+#ifndef ALLOC_COUNT_H
+#define ALLOC_COUNT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+///////////////////////////////////////
+// Heap Allocation Counter ////////////
+///////////////////////////////////////
+
+// Counts every malloc, calloc and realloc the process makes, including ones made by libraries.
+// Only active when built with CGAME_COUNT_ALLOCS, which wraps the heap functions at link time,
+// see the CGAME_COUNT_ALLOCS option in CMakeLists.txt
+
+// Whether heap allocations are being counted in this build
+bool AllocCountEnabled();
+
+// Number of heap allocations made so far, always 0 when counting is disabled
+uint64_t AllocCount();
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
+
+#endif
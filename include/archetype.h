@@ -0,0 +1,142 @@
+#ifndef ARCHETYPE_H
+#define ARCHETYPE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdalign.h>
+#include "../include/arena.h"
+#include "../include/dynamicarray.h"
+
+///////////////////////////////////////
+// Archetype Storage //////////////////
+///////////////////////////////////////
+
+// Optional storage for component data that the ECS's per-component sparse sets can be swapped for.
+// Entities with the same set of components (an archetype) are kept together in fixed-size chunks,
+// each component in its own contiguous column, so a system over several components is a straight
+// walk down the columns instead of a GetEntityIndex lookup per entity and component.
+// Entity IDs still come from the ECS (CreateEntity), the store only holds their component data.
+
+// Bytes in one chunk, header and every column included
+#define ARCHETYPE_CHUNK_SIZE (16 * 1024)
+
+// Component types are bits in an ArchetypeMask, so a store can have at most 64 of them
+#define ARCHETYPE_MAX_COMPONENTS 64
+
+// Marks a component that an archetype does not have in its column offsets, and an entity without a row
+#define ARCHETYPE_NONE UINT32_MAX
+
+typedef uint64_t ArchetypeMask;
+
+// Mask bit of a component ID
+#define ArchetypeBit(componentID) ((ArchetypeMask)1 << (componentID))
+
+// Chunk of up to capacity entities of one archetype, the columns follow the header
+typedef struct ArchetypeChunk
+{
+    // Next chunk in the store's free list while the chunk is unused
+    struct ArchetypeChunk *nextFree;
+    uint32_t count;
+} ArchetypeChunk;
+
+DynamicArrayDefine(ArchetypeChunks, ArchetypeChunk *);
+
+// Every entity with exactly the components in mask
+typedef struct Archetype
+{
+    ArchetypeMask mask;
+    // Entities per chunk, and where each column starts inside of a chunk (ARCHETYPE_NONE if absent),
+    // the entity ID column comes first
+    uint32_t capacity;
+    uint32_t entityColumn;
+    uint32_t columns[ARCHETYPE_MAX_COMPONENTS];
+    // Entities in the archetype, every chunk but the last is full
+    uint32_t count;
+    ArchetypeChunks chunks;
+} Archetype;
+
+DynamicArrayDefine(Archetypes, Archetype);
+
+typedef struct ArchetypeStore
+{
+    Arena *arena;
+    uint32_t maxEntities;
+    uint32_t componentCount;
+    uint32_t componentSizes[ARCHETYPE_MAX_COMPONENTS];
+    uint32_t componentAligns[ARCHETYPE_MAX_COMPONENTS];
+    // Archetypes are never removed, so their indices stay valid
+    Archetypes archetypes;
+    // Archetype index and row inside of it for every entity ID,
+    // row is ARCHETYPE_NONE for entities without any components in the store
+    uint32_t *entityArchetype;
+    uint32_t *entityRow;
+    // Chunks emptied by entities leaving an archetype, reused before pushing new ones
+    ArchetypeChunk *freeChunks;
+} ArchetypeStore;
+
+// Initialize an empty store for entity IDs below maxEntities, everything is allocated on arena
+//
+// Return - Boolean for success or failure
+bool ArchetypeStoreInit(ArchetypeStore *store, Arena *arena, uint32_t maxEntities);
+
+// Register a component type of size bytes aligned to align, register every type before adding any components
+//
+// Return - The component's ID, ARCHETYPE_NONE if there are already ARCHETYPE_MAX_COMPONENTS
+//          or the type does not fit in a chunk
+uint32_t ArchetypeRegisterComponent(ArchetypeStore *store, uint32_t size, uint32_t align);
+
+// Register a component type by name
+#define ArchetypeRegister(store, type) ArchetypeRegisterComponent(store, sizeof(type), alignof(type))
+
+// Give an entity a component, moving it to the archetype with that component added.
+// If it already has it the data is overwritten, data can be NULL to leave it zeroed
+//
+// Return - Boolean for success or failure
+bool ArchetypeAddComponent(ArchetypeStore *store, uint32_t entity, uint32_t componentID, const void *data);
+
+// Take a component away from an entity, moving it to the archetype without it
+//
+// Return - Boolean for success or failure
+bool ArchetypeRemoveComponent(ArchetypeStore *store, uint32_t entity, uint32_t componentID);
+
+// Remove an entity and all of its components from the store, removing its last component does the same
+//
+// Return - Boolean for success or failure
+bool ArchetypeRemoveEntity(ArchetypeStore *store, uint32_t entity);
+
+// Get an entity's component, only valid until the entity next changes archetype or another entity is removed
+//
+// Return - Pointer to the component, NULL if the entity does not have it
+void *ArchetypeGetComponent(ArchetypeStore *store, uint32_t entity, uint32_t componentID);
+
+// Iterates chunk by chunk over every archetype with all of the required and none of the excluded components
+typedef struct ArchetypeQuery
+{
+    ArchetypeStore *store;
+    ArchetypeMask required;
+    ArchetypeMask excluded;
+    uint32_t archetype;
+    uint32_t chunk;
+    // Entities in the current chunk, and their IDs
+    uint32_t count;
+    uint32_t *entities;
+} ArchetypeQuery;
+
+// Start a query, call ArchetypeQueryNext before reading from it
+ArchetypeQuery ArchetypeQueryBegin(ArchetypeStore *store, ArchetypeMask required, ArchetypeMask excluded);
+
+// Move on to the next non-empty matching chunk
+//
+// Return - False once every matching chunk has been visited
+bool ArchetypeQueryNext(ArchetypeQuery *query);
+
+// Get the column of a required component for the current chunk, count values long
+#define ArchetypeQueryColumn(query, type, componentID)\
+    ((type *)((unsigned char *)(query)->entities - (query)->store->archetypes.values[(query)->archetype].entityColumn +\
+              (query)->store->archetypes.values[(query)->archetype].columns[componentID]))
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
+
+#endif
@@ -5,29 +5,170 @@
 #include <stdbool.h>
 #include <stdalign.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 ///////////////////////////////////////
 // Arena Allocator ////////////////////
 ///////////////////////////////////////
 
+// Options for how an arena's memory is backed, combined as bit flags in ArenaParams
+typedef enum ArenaFlags
+{
+    ARENA_DEFAULT = 0,
+    // Back the arena with transparent huge pages and commit in 2MB steps,
+    // intended for large, hot arenas such as the ECS and component arenas
+    ARENA_HUGE_PAGES = 1 << 0,
+    // Same as ARENA_HUGE_PAGES but from the explicit hugetlbfs pool,
+    // falls back to transparent huge pages when the pool is too small
+    ARENA_HUGE_PAGES_EXPLICIT = 1 << 1,
+    // Fault in newly committed memory right away (MAP_POPULATE style),
+    // for hot arenas where first-touch page faults would land mid-frame
+    ARENA_PREFAULT = 1 << 2,
+    // Allow any number of threads to push at the same time, offsets are claimed with an atomic
+    // fetch-add and only one thread at a time extends the committed range.
+    // Pop, clear and temps are NOT thread safe and need every pushing thread to be done.
+    ARENA_CONCURRENT = 1 << 3,
+    // Grow by chaining separately reserved blocks of blockSize bytes instead of reserving
+    // one huge range up front, for environments with ulimit -v or strict overcommit.
+    // Every push is still contiguous, but consecutive pushes are not guaranteed to be.
+    // Can not be combined with ARENA_CONCURRENT.
+    ARENA_CHAINED = 1 << 4
+} ArenaFlags;
+
+// Parameters for ArenaAllocParams, zeroed fields use the defaults
+typedef struct ArenaParams
+{
+    // Bytes of address space to reserve, 0 for the default reservation.
+    // For ARENA_CHAINED arenas this caps the total size of all blocks, 0 for no cap
+    uint64_t reserveSize;
+    // Size of each block of an ARENA_CHAINED arena, 0 for the default (4MB),
+    // pushes larger than a block get a block of their own
+    uint64_t blockSize;
+    // Commit ahead in steps of this many bytes, rounded up to the page size,
+    // 0 for the default (64KB, or 2MB for huge page arenas)
+    uint64_t commitSize;
+    // ArenaFlags
+    uint32_t flags;
+} ArenaParams;
+
+// Most distinct tags one arena tracks, pushes with any further tags count as untagged
+#define ARENA_MAX_TAGS 32
+
+// Bytes and pushes made under one tag, tags[0] of every arena is "untagged"
+typedef struct ArenaTagStats
+{
+    const char *tag;
+    uint64_t bytes;
+    uint64_t pushes;
+} ArenaTagStats;
+
+// Header at the start of every block of an ARENA_CHAINED arena
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *prev;
+    // Arena offset that the first byte after this header corresponds to
+    uint64_t base;
+    // Bytes reserved for the block, header included, and bytes of it committed
+    uint64_t size;
+    uint64_t committed;
+} ArenaBlock;
+
 // Arena allocator, store multiple allocations in one place
 // to bundle frees together
+//
+// For ARENA_CHAINED arenas arena, pages, committed and reserved describe the current block,
+// while offset is the total across all blocks
 typedef struct Arena
 {
     unsigned char *arena;
     uint64_t offset;
+    // Number of regular OS pages committed
     uint32_t pages;
+    // Bytes committed and reserved, committed is always a multiple of the commit granularity
+    uint64_t committed;
+    uint64_t reserved;
+
+    // Current block of an ARENA_CHAINED arena and blocks emptied by rewinding, NULL otherwise
+    ArenaBlock *block;
+    ArenaBlock *spareBlocks;
+    // Offset of the first byte after the current block's header, and the chain's size settings
+    uint64_t blockBase;
+    uint64_t blockSize;
+    uint64_t sizeLimit;
+
+    // Commit granularity in bytes
+    uint64_t commitSize;
+    uint32_t flags;
+    // Held by the thread extending the committed range of an ARENA_CONCURRENT arena
+    bool commitLock;
+
+    // Decommit policy, see ArenaSetDecommitPolicy, decommitFrames of 0 means disabled
+    uint64_t decommitThreshold;
+    uint32_t decommitFrames;
+    // Consecutive frames the arena has stayed at or below decommitThreshold
+    uint32_t framesBelow;
+    // Highest offset reached since the last ArenaFrameEnd
+    uint64_t framePeak;
+
+    // Instrumentation, see ArenaGetStats
+    uint64_t highWater;
+    uint64_t pushCount;
+    uint64_t paddingBytes;
+    ArenaTagStats tags[ARENA_MAX_TAGS];
+    uint32_t tagCount;
+    // Index in tags that untagged pushes are counted under, see ArenaSetTag
+    uint32_t currentTag;
 } Arena;
 
-// Allocate an arena
+// Snapshot of an arena's memory use, tags points into the arena and is only valid while it exists
+typedef struct ArenaStats
+{
+    uint64_t reserved;
+    uint64_t committed;
+    uint64_t used;
+    uint64_t highWater;
+    uint64_t pushCount;
+    // Bytes skipped to satisfy alignment
+    uint64_t paddingBytes;
+    const ArenaTagStats *tags;
+    uint32_t tagCount;
+} ArenaStats;
+
+// Allocate an arena with the default parameters
 Arena *ArenaAlloc();
-// Deallocate an arena
+// Allocate an arena with the given reservation size and flags
+Arena *ArenaAllocParams(ArenaParams params);
+// Change the parameters ArenaAlloc uses, and the size settings (and ARENA_CHAINED)
+// that ArenaAllocParams falls back to when given neither reserveSize nor blockSize
+void ArenaSetDefaultParams(ArenaParams params);
+// Deallocate an arena, releasing its memory and the Arena itself
 void ArenaDealloc(Arena *arena);
 
 // Push some amount of bytes onto the arena
 void *ArenaPush(Arena *arena, uint64_t allocSize, uint64_t align);
 // Push some amount of zero bytes onto the arena
 void *ArenaPushZero(Arena *arena, uint64_t allocSize, uint64_t align);
+// Push some amount of bytes onto the arena, accounted under tag instead of the current tag.
+// On ARENA_CONCURRENT arenas a tag has to be seen once (ArenaSetTag) before threads push with it.
+void *ArenaPushTagged(Arena *arena, uint64_t allocSize, uint64_t align, const char *tag);
+
+// Get the address right after the last push, where a push with no alignment padding would start
+void *ArenaTop(Arena *arena);
+
+// Account every following push without an explicit tag under tag, such as "ecs.signatures",
+// NULL goes back to untagged. Tags are compared by pointer first, so string literals are cheapest.
+//
+// Return - The previous tag, so callers can restore it
+const char *ArenaSetTag(Arena *arena, const char *tag);
+
+// Get the arena's current memory use, high water mark, push count, padding and per-tag breakdown
+ArenaStats ArenaGetStats(Arena *arena);
+
+// Write the CSV column names for ArenaWriteStatsCSV
+void ArenaWriteStatsCSVHeader(FILE *file);
+
+// Write one "total" row for the arena followed by one row per tag, name identifies the arena
+void ArenaWriteStatsCSV(Arena *arena, const char *name, FILE *file);
 
 // Remove some amount of bytes from the top of the arena
 void ArenaPop(Arena *arena, uint64_t popSize);
@@ -35,12 +176,121 @@ void ArenaPop(Arena *arena, uint64_t popSize);
 // Empty out arena, set offset to 0
 void ArenaClear(Arena *arena);
 
+// Give committed memory above max(offset, keepSize) back to the OS, rounded up to the commit granularity
+//
+// Return - Boolean for success or failure
+bool ArenaDecommit(Arena *arena, uint64_t keepSize);
+
+// Shrink the arena's committed memory down to threshold bytes once its usage has stayed at
+// or below threshold for frames calls of ArenaFrameEnd in a row, frames of 0 disables the policy.
+// The delay keeps an arena that spikes every few frames from committing and decommitting constantly.
+void ArenaSetDecommitPolicy(Arena *arena, uint64_t threshold, uint32_t frames);
+
+// Mark the end of a frame for the decommit policy, call once per frame after the arena's last use
+void ArenaFrameEnd(Arena *arena);
+
+// Saved position in an arena, everything pushed after ArenaTempBegin
+// is released again by the matching ArenaTempEnd
+typedef struct ArenaTemp
+{
+    Arena *arena;
+    uint64_t offset;
+} ArenaTemp;
+
+// Begin a block of temporary allocations on the arena
+ArenaTemp ArenaTempBegin(Arena *arena);
+
+// Rewind the arena to where the matching ArenaTempBegin left it
+void ArenaTempEnd(ArenaTemp temp);
+
+// Number of scratch arenas each thread owns, a function can get a scratch arena
+// that does not collide with up to ARENA_SCRATCH_COUNT - 1 arenas passed in by its callers
+#define ARENA_SCRATCH_COUNT 2
+
+// Begin temporary allocations on one of the calling thread's scratch arenas,
+// picking one that is not in conflicts, the arenas are created on first use.
+// Scratch arenas are never shared between threads, so no locking is needed.
+//
+// Return - ArenaTemp to pass to ArenaScratchEnd, arena is NULL if every scratch arena conflicts
+ArenaTemp ArenaScratchBegin(Arena **conflicts, uint32_t conflictCount);
+
+// Release everything pushed onto the scratch arena since ArenaScratchBegin
+#define ArenaScratchEnd(temp) ArenaTempEnd(temp)
+
+// Deallocate the calling thread's scratch arenas, call before a worker thread exits
+void ArenaScratchRelease();
+
+// Block of a chained arena saved in an ArenaCheckpoint, and the offset it started at when saved
+typedef struct ArenaCheckpointBlock
+{
+    ArenaBlock *block;
+    uint64_t base;
+} ArenaCheckpointBlock;
+
+// Copy of everything pushed onto an arena, taken with ArenaSnapshot and put back with ArenaRestore.
+// Zero initialize before the first ArenaSnapshot, and free with ArenaCheckpointFree
+typedef struct ArenaCheckpoint
+{
+    Arena *arena;
+    unsigned char *data;
+    uint64_t offset;
+    uint64_t capacity;
+    ArenaCheckpointBlock *blocks;
+    uint32_t blockCount;
+    uint32_t blockCapacity;
+    // Pages copied by the last ArenaSnapshot, the rest had not changed since the snapshot before it
+    uint64_t dirtyPages;
+} ArenaCheckpoint;
+
+// Copy the arena's used range into checkpoint. Taking a snapshot into a checkpoint
+// that already holds one of the same arena only copies the pages that changed since.
+// Must not be called while other threads push onto an ARENA_CONCURRENT arena.
+//
+// Return - Boolean for success or failure
+bool ArenaSnapshot(Arena *arena, ArenaCheckpoint *checkpoint);
+
+// Put the arena back to exactly how it was when checkpoint was taken, everything pushed
+// since is released and every pointer into the snapshotted range is valid again.
+// Fails without changing anything if checkpoint is of another arena, or a chained arena
+// has since released one of the blocks it needs (ArenaDecommit drops spare blocks).
+//
+// Return - Boolean for success or failure
+bool ArenaRestore(Arena *arena, const ArenaCheckpoint *checkpoint);
+
+// Free the memory held by a checkpoint, it can be reused as if zero initialized afterwards
+void ArenaCheckpointFree(ArenaCheckpoint *checkpoint);
+
+// Self-relative reference, the distance in bytes from the ArenaRel itself to what it refers to, 0 for NULL.
+// Structures that only refer to each other through these keep working wherever their arena is mapped,
+// such as an image from ArenaLoadImage, as long as everything they refer to lives in that same arena.
+// They can not be copied by value, the copy would refer to somewhere else
+typedef int64_t ArenaRel;
+
+// Pointer to type that the ArenaRel lvalue rel refers to
+#define ArenaRelPtr(type, rel) ((rel) != 0 ? (type *)((unsigned char *)&(rel) + (rel)) : (type *)NULL)
+// Make the ArenaRel lvalue rel refer to ptr
+#define ArenaRelSet(rel, ptr) ((rel) = ((ptr) != NULL) ? (ArenaRel)((unsigned char *)(ptr) - (unsigned char *)&(rel)) : 0)
+
+// Write the arena's used range to a file at path, root is the object (usually the first push)
+// that ArenaLoadImage hands back. Chained arenas are not contiguous and can not be saved.
+//
+// Return - Boolean for success or failure
+bool ArenaSaveImage(Arena *arena, const char *path, void *root);
+
+// Make a new arena out of an image written by ArenaSaveImage, the file is mapped copy-on-write
+// so only the pages that get touched are read, and writes never reach the file.
+// The arena reserves max(reserveSize, image size) so it can keep growing past the image.
+//
+// Return - The new arena, with *root set to the saved root, NULL on failure
+Arena *ArenaLoadImage(const char *path, uint64_t reserveSize, void **root);
+
 // Macros for ease of read/writing
 #define PushDefaultAlign(arena, count) ArenaPush(arena, size, DEFAULT_ALIGN)
-#define PushArray(arena, type, count) ArenaPush(arena, sizeof(type) * count, alignof(type))
-#define PushArrayZero(arena, type, count) ArenaPushZero(arena, sizeof(type) * count, alignof(type))
+#define PushArray(arena, type, count) ArenaPush(arena, sizeof(type) * (count), alignof(type))
+#define PushArrayZero(arena, type, count) ArenaPushZero(arena, sizeof(type) * (count), alignof(type))
 #define PushStruct(arena, type) PushArray(arena, type, 1)
 #define PushStructZero(arena, type) PushArrayZero(arena, type, 1)
+#define PushArrayTagged(arena, type, count, tag) ArenaPushTagged(arena, sizeof(type) * (count), alignof(type), tag)
 
 ///////////////////////////////////////
 ///////////////////////////////////////
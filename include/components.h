@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include "../include/raylib.h"
 #include "../include/util.h"
+#include "../include/ecs.h"
 
 // Position
 typedef struct Position
@@ -117,7 +118,7 @@ typedef struct ControllerSet
 // Follower
 typedef struct Follower
 {
-    uint32_t followID;
+    EntityHandle follow;
 } Follower;
 
 typedef struct FollowerSet
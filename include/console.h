@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include "../include/raylib.h"
 #include "../include/arena.h"
+#include "../include/pool.h"
 
 typedef struct ConsoleMessage
 {
@@ -20,6 +21,8 @@ typedef struct Console
     Color outlineColor;
 
     ConsoleMessage *messages;
+    // Message text storage, each message only takes up as much as it needs, up to charLimit
+    Pool strings;
     uint32_t numMessages;
     uint32_t maxMessages;
     uint32_t charLimit;
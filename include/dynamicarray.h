@@ -2,48 +2,82 @@
 #define DYNAMIC_ARRAY_H
 
 #include "../include/arena.h"
-#include "../include/raylib.h"
-#include "../include/windows_utils.h"
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 
-typedef struct DynamicTiles
-{
-    
-    Arena *arena;
-    Color *values;
-    int32_t len;
-    int32_t capacity;
-} DynamicTiles;
-
-#define InitDynamicArray(dynamicArray, type) {\
-    dynamicArray.arena = ArenaAlloc();\
-    dynamicArray.values = (type *)dynamicArray.arena->arena;\
-    dynamicArray.len = 0;\
-    dynamicArray.capacity = 0;\
-}
-#define PushArrayDynamic(dynamicArray, type, value) {\
-    PushStruct(dynamicArray.arena, type);\
-    dynamicArray.capacity++;\
-    dynamicArray.values[dynamicArray.len] = value;\
-    dynamicArray.len++;\
-}
-#define PopArrayDynamic(dynamicArray, count) {\
-    ArenaPop(dynamicArray.arena, sizeof(*dynamicArray.values) * count);\
-    dynamicArray.capacity -= count;\
-    if (dynamicArray.len >= dynamicArray.capacity) dynamicArray.len = dynamicArray.capacity;\
-}
-#define AppendArrayDynamic(dynamicArray, value) dynamicArray.values[dynamicArray.len] = value, dynamicArray.len++;
-#define DynamicResize(dynamicArray, type, size) {\
-    if (dynamicArray.capacity > size)\
-    {\
-        ArenaPop(dynamicArray.arena, (dynamicArray.capacity - size) * sizeof(type));\
-        if (dynamicArray.len >= size) dynamicArray.len = size;\
-    }\
-    else\
-    {\
-        PushArray(dynamicArray.arena, type, size - dynamicArray.capacity);\
-    }\
-    dynamicArray.capacity = size;\
+///////////////////////////////////////
+// Dynamic Array //////////////////////
+///////////////////////////////////////
+
+// Capacity of an array the first time it grows
+#define DYNAMIC_ARRAY_MIN_CAPACITY 16
+
+// Declare a dynamic array type called name holding values of type, for example
+// DynamicArrayDefine(DynamicColors, Color);
+//
+// The values live in arena, many arrays can share one arena. An array on top of its arena
+// grows in place, otherwise it moves to the top with double the capacity, leaving the
+// old values behind until the arena is cleared
+#define DynamicArrayDefine(name, type) typedef struct name\
+{\
+    Arena *arena;\
+    type *values;\
+    uint32_t len;\
+    uint32_t capacity;\
+} name
+
+// Grow the array whose values are at *valuesPtr to hold at least needed values, used by the macros below
+//
+// Return - Boolean for success or failure, nothing changes on failure
+bool DynamicArrayGrow(Arena *arena, void *valuesPtr, uint32_t len, uint32_t *capacity, uint32_t needed, uint64_t valueSize);
+
+// Give the unused capacity back to the arena if the array is on top of it
+void DynamicArrayShrink(Arena *arena, void *values, uint32_t len, uint32_t *capacity, uint64_t valueSize);
+
+// Set up an empty array on arena, nothing is pushed until the first value is added
+#define DynamicArrayInit(array, arenaptr) {\
+    (array).arena = (arenaptr);\
+    (array).values = NULL;\
+    (array).len = 0;\
+    (array).capacity = 0;\
 }
 
+// Make room for at least count values without changing len
+//
+// Return - Boolean for success or failure
+#define DynamicArrayReserve(array, count) ((uint64_t)(count) <= (array).capacity ||\
+    DynamicArrayGrow((array).arena, &(array).values, (array).len, &(array).capacity, (count), sizeof(*(array).values)))
+
+// Add value to the end of the array, amortized O(1)
+//
+// Return - Boolean for success or failure
+#define DynamicArrayPush(array, value) (DynamicArrayReserve(array, (array).len + 1) ?\
+    ((array).values[(array).len++] = (value), true) : false)
+
+// Copy count values from src onto the end of the array
+//
+// Return - Boolean for success or failure
+#define DynamicArrayAppend(array, src, count) (DynamicArrayReserve(array, (array).len + (count)) ?\
+    (memcpy(&(array).values[(array).len], (src), sizeof(*(array).values) * (count)), (array).len += (count), true) : false)
+
+// Set len to count, values added at the end are left uninitialized
+//
+// Return - Boolean for success or failure
+#define DynamicArrayResize(array, count) (DynamicArrayReserve(array, (count)) ? ((array).len = (count), true) : false)
+
+// Remove count values from the end of the array, the capacity is kept
+#define DynamicArrayPop(array, count) ((array).len -= ((count) < (array).len) ? (count) : (array).len)
+
+// Remove every value, the capacity is kept
+#define DynamicArrayClear(array) ((array).len = 0)
+
+// Give unused capacity back to the arena, only possible while nothing was pushed onto it after the array
+#define DynamicArrayShrinkToFit(array)\
+    DynamicArrayShrink((array).arena, (array).values, (array).len, &(array).capacity, sizeof(*(array).values))
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
+
 #endif
@@ -4,7 +4,10 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <stdalign.h>
 #include "../include/arena.h"
+#include "../include/dynamicarray.h"
+#include "../include/jobs.h"
 #include "event.h"
 
 ////
@@ -21,11 +24,7 @@
 //
 //      Maybe translate -1 underflow returns to true/false returns for ease of use on user end
 //
-//      Increase usability and readabiliy, functionize some things currently done maunally,
-//          maybe turn the triple if(BITTEST...) sets into a function of some sort.
-//          Maybe do it by making one Bitset and feeding it to a function that compares?
-//          Also look into automatically handling component removal, instead of
-//          having to call ECSClearComponent or ECSRemoveEntity and THEN using the macro a bunch of times.
+//      Increase usability and readabiliy, functionize some things currently done maunally
 
 
 // Tree of ECS members and what they do
@@ -34,32 +33,41 @@
 // - EntityData
 //     - maxEntities
 //     - currentEntities
+//     - nextUnused
+//         - every ID below it has been handed out at least once, the rest have never been touched
 //     - IDQueue 
-//         - ring buffer of available IDs
-//     - Bitset *
-//         - array of signatures, index in char array represents component ID,
+//         - ring buffer of removed IDs, handed out again once every ID has been used
+//     - eSignatures
+//         - signatureWords 64 bit words per entity, back to back, bit n represents component ID n,
 //           set bit means entity has that type, un-set bit means entity does not
 // - ComponentDict
 //     - Remember, each ComponentDict is associated to a component type, these are registered at runtime,
 //       component ID given by ECS is used as index in ComponentDict array
 //     - indexToEntity
-//         - Simple hashmap, key is index of component in component array, value is entity ID that owns it
+//         - Dense array, key is index of component in component array, value is entity ID that owns it,
+//           grows as entities get the component
 //     - entityToIndex
-//         - Simple hashmap, key is ID of entity, value is index of component it owns in component array 
+//         - Paged sparse array, key is ID of entity, value is index of component it owns in component array,
+//           a page is only allocated once an entity in its range gets the component, until then it is
+//           the ECS's shared page of -1's
+//     - changed
+//         - Dense array next to indexToEntity, the change tick each entity's value was last written at
 //     - size (amount of entities that own that component type)
+//     - valueSize, valueAlign (of the component type, so the ECS can move its data itself)
 // - MaxComponents
 // - CurrentComponents
+// - changeTick (stamped into changed by every write through the mutable accessors)
 
 
 ///////////////////////////////////////
 /// Array Queue (For entitiy IDs) /////
 ///////////////////////////////////////
 
-// Ring buffer, used for entity IDs, ideal because
+// Ring buffer, used for removed entity IDs, ideal because
 // the number of entity IDs is constant for any given ECS
 typedef struct IDQueue
 {
-    uint32_t *arr;
+    ArenaRel arr; // uint32_t *
     uint32_t capacity; // Max ids it can hold
     uint32_t size;   // Current number of ids it is holding
     uint32_t head;
@@ -72,28 +80,31 @@ typedef struct IDQueue
 
 
 ///////////////////////////////////////
-/// Bitset (For entity signatures) ////
+/// Signatures ////////////////////////
 ///////////////////////////////////////
 
-#define BITMASK(bit) (1 << ((bit) & CHAR_BIT))
-#define BITSLOT(bit) ((bit) / CHAR_BIT)
+// Signatures track what components an entity does or doesn't have, one bit per component ID
+// in an array of 64 bit words. Every signature in an ECS is signatureWords long, enough for maxComponents
+#define ECS_SIGNATURE_WORD_BITS 64
+
+// Widest signature in words, an ECS can have at most 64 * ECS_SIGNATURE_MAX_WORDS components
+#define ECS_SIGNATURE_MAX_WORDS 4
+
+#define BITMASK(bit) ((uint64_t)1 << ((bit) % ECS_SIGNATURE_WORD_BITS))
+#define BITSLOT(bit) ((bit) / ECS_SIGNATURE_WORD_BITS)
 #define BITSET(arr, i) ((arr)[BITSLOT(i)] |= BITMASK(i))
 #define BITCLEAR(arr, i) ((arr)[BITSLOT(i)] &= ~BITMASK(i))
 #define BITTEST(arr, i) ((arr)[BITSLOT(i)] & BITMASK(i))
-#define BITNSLOTS(nbits) ((nbits + CHAR_BIT - 1) / CHAR_BIT)
-
-// Bitset ported from C++, used to store signatures for entities,
-// which are used to track what components they do or don't have
-typedef struct Bitset
-{
-    char *bits;
-    uint32_t size;
-} Bitset;
+#define BITNSLOTS(nbits) (((nbits) + ECS_SIGNATURE_WORD_BITS - 1) / ECS_SIGNATURE_WORD_BITS)
 
-// Initialize BitSet struct, allocated onto given arena
-// 
-// Return - Boolean for success or failure
-bool InitBitset(Bitset *b, Arena *mem, uint32_t size);
+// Filter entities by signature, an entity matches if it has every bit in required and none in excluded.
+// entities lists the IDs to test, or NULL to test IDs 0 to count - 1. The position in entities
+// (or the ID) of every match is written to matches, which must have room for count values.
+// One word signatures are matched with AVX2 or SSE2 when the build targets them
+//
+// Return - Number of matches
+uint32_t ECSMatchSignatures(const uint64_t *signatures, uint32_t signatureWords, const uint64_t *required, const uint64_t *excluded,
+                            const uint32_t *entities, uint32_t count, uint32_t *matches);
 
 ///////////////////////////////////////
 ///////////////////////////////////////
@@ -104,30 +115,54 @@ bool InitBitset(Bitset *b, Arena *mem, uint32_t size);
 /// EntityData ////////////////////////
 ///////////////////////////////////////
 
-// Stores current/max number of entities, a queue of available IDs,
-// and an array of Bitset signatures to track what components an entity possesses
+// Entity IDs are reused once removed, so references kept across ticks should be handles instead:
+// the ID packed with the generation of its slot, which changes every time the ID is created or removed.
+// A handle to a removed entity never matches again, even after its ID is reused
+typedef uint32_t EntityHandle;
+
+// Low bits of a handle are the entity ID, the rest its generation, so an ECS holds fewer than 2^20 entities
+#define ENTITY_INDEX_BITS 20
+#define ENTITY_INDEX_MASK ((1u << ENTITY_INDEX_BITS) - 1)
+#define ENTITY_GENERATION_MASK ((1u << (32 - ENTITY_INDEX_BITS)) - 1)
+
+// Handle that never refers to an entity
+#define ENTITY_HANDLE_NONE UINT32_MAX
+
+#define EntityHandleIndex(handle) ((uint32_t)(handle) & ENTITY_INDEX_MASK)
+#define EntityHandleGeneration(handle) ((uint32_t)(handle) >> ENTITY_INDEX_BITS)
+
+// Stores current/max number of entities, where new IDs come from,
+// and the signatures that track what components an entity possesses.
+// Per-ID state (signature, generation, ComponentDict entries) is only written once CreateEntity
+// first hands the ID out, so initializing is O(1) and untouched IDs never fault their pages in
 typedef struct EntityData
 {
     uint32_t currentEntities;
     uint32_t maxEntities;
+    // Next never-used ID, handed out before any removed ID is reused
+    uint32_t nextUnused;
+    // Removed IDs waiting to be reused
     IDQueue eIDs;
-    Bitset *eSignatures;
+    ArenaRel eSignatures; // uint64_t *, signatureWords per entity
+    uint32_t signatureWords;
+    // Generation of every ID, odd while the ID is in use
+    ArenaRel generations; // uint16_t *
 } EntityData;
 
-// Initialize EntityData struct, allocated onto given arena
+// Initialize EntityData struct with signatures wide enough for maxComponents, allocated onto given arena
 //
 // Return - Boolean for success or failure
-bool InitEntityData(EntityData *m, Arena *mem, uint32_t maxEntities);
+bool InitEntityData(EntityData *m, Arena *mem, uint32_t maxEntities, uint32_t maxComponents);
 
-// Set signature for entity in EntityData struct, using given Bitset
+// Set signature for entity in EntityData struct, copying signatureWords words
 //
 // Return - Boolean for success or failure
-bool SetSignature(EntityData *m, uint32_t entity, Bitset signature);
+bool SetSignature(EntityData *m, uint32_t entity, const uint64_t *signature);
 
 // Get signature for entity from EntityData struct
 //
-// Return - Bitset signature
-Bitset *GetSignature(EntityData *m, uint32_t entity);
+// Return - Pointer to the signature's words, NULL if entity was never created
+uint64_t *GetSignature(EntityData *m, uint32_t entity);
 
 ///////////////////////////////////////
 ///////////////////////////////////////
@@ -138,25 +173,43 @@ Bitset *GetSignature(EntityData *m, uint32_t entity);
 /// ComponentDict /////////////////////
 ///////////////////////////////////////
 
+// Entity IDs per page of a ComponentDict's entityToIndex, one page is 4KB
+#define ECS_SPARSE_PAGE_SIZE 1024
+
 // Represents the associations between entities and component,
-// for ONE component type, as well as the amount of entities that posess that component
+// for ONE component type, as well as the amount of entities that posess that component.
+// Only the page table scales with maxEntities, everything else with the entities that have the component
 typedef struct ComponentDict
 {
-    uint32_t *entityToIndex;
-    uint32_t *indexToEntity;
+    // Page table, one ArenaRel per ECS_SPARSE_PAGE_SIZE entity IDs to a page of indices (-1 if absent).
+    // Every entry refers to emptyPage until an entity in the page's range gets the component,
+    // so lookups never have to check for a missing page
+    ArenaRel entityToIndex; // ArenaRel *, get a page with ECSSparsePage
+    ArenaRel emptyPage; // uint32_t *
+    ArenaRel indexToEntity; // uint32_t *, capacity values
+    // Change tick every value was last written at, by dense index like indexToEntity
+    ArenaRel changed; // uint32_t *, capacity values
+    uint32_t capacity;
+    // The component's data array, set by RegisterComponent so BindComponent and queries can find it again
+    ArenaRel data;
+    // Size and alignment of one value in data, set by RegisterComponent so removals can move values without knowing the type
+    uint32_t valueSize;
+    uint32_t valueAlign;
     // Current number of entries
     uint32_t size;
 } ComponentDict;
 
-// Initialize ComponentDict struct, allocated onto given arena
+// Initialize ComponentDict struct with every page referring to emptyPage, a page of ECS_SPARSE_PAGE_SIZE -1's
+// that is never written to, allocated onto given arena
 //
 // Return - Boolean for success or failure
-bool InitComponentDict(ComponentDict *c, Arena *mem, uint32_t maxEntities);
+bool InitComponentDict(ComponentDict *c, Arena *mem, uint32_t maxEntities, uint32_t *emptyPage);
 
-// Add an entity to a ComponentDict
+// Add an entity to a ComponentDict, its page and room in the dense array are pushed onto mem when needed.
+// Its change tick starts at 0, AssociateComponent stamps it with the ECS's
 //
 // Return - Boolean for success or failure
-bool AddComponentDict(uint32_t entity, ComponentDict *container);
+bool AddComponentDict(uint32_t entity, ComponentDict *container, Arena *mem);
 
 // Remove an entity from a ComponentDict
 //
@@ -171,41 +224,319 @@ bool RemoveComponentDict(uint32_t entity, ComponentDict *container);
 /// Entity Component System ///////////
 ///////////////////////////////////////
 
+// How queries find the entities that match them
+typedef enum ECSQueryBackend
+{
+    // Walk the smallest required component's dense array and match each entity's signature
+    ECS_QUERY_SPARSE_SETS = 0,
+    // AND together one bitmap over every entity ID per component, then bit-scan the result
+    ECS_QUERY_BIT_PLANES = 1
+} ECSQueryBackend;
+
 // Contains all entity data, component-entity associations, and counts of components/entities,
 // but does NOT contain any actual component data
+//
+// Every reference inside of the ECS is an ArenaRel, so an ECS whose components were registered
+// on its own arena can be saved with ArenaSaveImage and used straight out of ArenaLoadImage
 typedef struct ECS
 {
+    // Arena the ECS was initialized on, sparse pages and dense arrays grow onto it.
+    // Not saved in images, an ECS from ArenaLoadImage needs ECSBindArena before anything is added to it
+    Arena *arena;
     EntityData entities;
-    ComponentDict *components;
+    ArenaRel components; // ComponentDict *, get with ECSComponents
+    // Page of -1's every ComponentDict refers to for entity ID ranges without the component
+    ArenaRel emptyPage; // uint32_t *
     uint32_t maxComponents;
     uint32_t currentComponents;
+    // One bitmap of planeWords words per component, bit n set if entity n has the component.
+    // Only allocated and kept up to date once ECSSetQueryBackend has asked for ECS_QUERY_BIT_PLANES
+    ArenaRel bitPlanes; // uint64_t *, get with ECSBitPlane
+    uint32_t planeWords;
+    ECSQueryBackend queryBackend;
+    // Stamped into a component's changed array whenever a value is added or written through
+    // a mutable accessor, only goes up through ECSAdvanceTick
+    uint32_t changeTick;
 } ECS;
 
 // Initializes ECS struct, allocates on the given arena
 //
-// Return - Boolean for success or failure
+// Return - Boolean for success or failure, fails if maxComponents is above 64 * ECS_SIGNATURE_MAX_WORDS
+//          or maxEntities is not below 2^ENTITY_INDEX_BITS
 bool ECSInit(ECS *ecs, Arena *mem, uint32_t maxEntities, uint32_t maxComponents);
 
+// Point an ECS that was not set up in this run, such as one loaded with ArenaLoadImage, at the arena it lives in
+void ECSBindArena(ECS *ecs, Arena *mem);
+
 // Create an entity/ID
 // 
 // Return - uint32_t entity ID
 uint32_t CreateEntity(ECS *ecs);
 
-// Remove an entity/ID, set signature to all 0's, remove all associations in ComponentDicts
+// Remove an entity/ID along with every component it has, data included, in O(components it has)
 //
-// Return - Boolean for success or failure
+// Return - Boolean for success or failure, fails if the entity was already removed
 bool RemoveEntity(uint32_t entity, ECS *ecs);
 
+// Get a handle to the entity currently using an ID, to keep instead of the ID
+//
+// Return - The handle, ENTITY_HANDLE_NONE if the ID was never created
+EntityHandle GetEntityHandle(ECS *ecs, uint32_t entity);
+
+// Check in O(1) that the entity a handle was made for has not been removed since
+//
+// Return - True if it still exists
+bool ECSIsAlive(ECS *ecs, EntityHandle handle);
+
 // Associate an entity with a component ID, where the ID serves as an index in the ECS ComponentDict array
 //
 // Return - Boolean for success or failure
 bool AssociateComponent(uint32_t entity, ECS *ecs, uint32_t componentID);
 
-// Remove association between an entity and component ID, where the ID serves as an index in the ECS ComponentDict array
+// Remove association between an entity and component ID, where the ID serves as an index in the ECS ComponentDict array.
+// Leaves the component data array alone, ECSRemoveComponent keeps the two in step
 //
 // Return - Boolean for success or failure
 bool UnassociateComponent(uint32_t entity, ECS *ecs, uint32_t componentID);
 
+// Take a component away from an entity, moving the component's last value into the removed one's place
+// the same way its association is swapped out
+//
+// Return - Boolean for success or failure, fails if the entity does not have the component
+bool ECSRemoveComponent(uint32_t entity, ECS *ecs, uint32_t componentID);
+
+// Start a new change tick, every value written from here on is stamped with the returned tick.
+// A system that keeps the tick it got back and later filters a query with ECSQueryChangedSince on it
+// visits everything written in between, including what was written after it ran in the same frame
+//
+// Return - The new tick
+uint32_t ECSAdvanceTick(ECS *ecs);
+
+// Stamp an entity's value of a component with the current change tick, for writes outside of queries
+//
+// Return - The entity's index in the component array, UINT32_MAX if it does not have the component
+uint32_t ECSMarkChanged(ECS *ecs, uint32_t entity, uint32_t componentID);
+
+// Choose the backend queries started after this use. The first switch to ECS_QUERY_BIT_PLANES
+// builds the bit-planes on mem from the current signatures, from then on they are kept up to date
+// with every component change, also after switching back
+//
+// Return - Boolean for success or failure
+bool ECSSetQueryBackend(ECS *ecs, Arena *mem, ECSQueryBackend backend);
+
+// AND wordCount words of each required bit-plane together and clear the bits set in any excluded one,
+// uses AVX2 or SSE2 when the build targets them. Bit-plane queries combine their planes with it
+void ECSCombineBitPlanes(const uint64_t *const *required, uint32_t requiredCount,
+                         const uint64_t *const *excluded, uint32_t excludedCount, uint32_t wordCount, uint64_t *out);
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
+
+
+///////////////////////////////////////
+/// ECS Queries ///////////////////////
+///////////////////////////////////////
+
+// Most components a query can require
+#define ECS_QUERY_MAX_COMPONENTS 8
+
+// Entities the query matches against its masks in one ECSMatchSignatures call,
+// and the most one bit-plane word can produce
+#define ECS_QUERY_BATCH 64
+
+// Plane words a bit-plane query combines in one ECSCombineBitPlanes call before bit-scanning them
+#define ECS_QUERY_PLANE_BLOCK 64
+
+// A sparse set query filtered by ECSQueryChangedSince is driven by the filtered component instead,
+// as long as it has at most this many times the entities of the smallest one
+#define ECS_QUERY_CHANGED_DRIVER_RATIO 4
+
+// Iterates every entity that has all of the required and none of the excluded components.
+// With sparse sets the smallest required component's array drives the iteration, its entities are
+// matched a batch at a time by comparing whole signatures against the query's masks.
+// With bit-planes the required planes are ANDed together a block of words at a time, the excluded ones cleared,
+// and the set bits are the matching entity IDs in order. Bit-planes also take at most
+// ECS_QUERY_MAX_COMPONENTS excluded components, queries with more use sparse sets.
+//
+// Entities must not be removed and required components must not be added or removed while iterating,
+// collect them and do it afterwards
+typedef struct ECSQuery
+{
+    ECS *ecs;
+    uint64_t requiredMask[ECS_SIGNATURE_MAX_WORDS];
+    uint64_t excludedMask[ECS_SIGNATURE_MAX_WORDS];
+    uint32_t requiredCount;
+    // Per required component, its ComponentDict, entity to index page table, data and change ticks
+    ComponentDict *components[ECS_QUERY_MAX_COMPONENTS];
+    ArenaRel *entityToIndex[ECS_QUERY_MAX_COMPONENTS];
+    void *data[ECS_QUERY_MAX_COMPONENTS];
+    uint32_t *changed[ECS_QUERY_MAX_COMPONENTS];
+    // The ECS's change tick when the query began, what ECSQueryComponentMut stamps
+    uint32_t tick;
+    // Required component whose change tick has to be at least changedSince, requiredCount or above for none
+    uint32_t changedTerm;
+    uint32_t changedSince;
+    // Position of the driving component among the required ones, NULL driver if the query is invalid.
+    // Bit-plane queries have no driver term and no driver entities
+    uint32_t driverTerm;
+    ComponentDict *driver;
+    uint32_t *driverEntities;
+    uint64_t *signatures;
+    // Planes of the required and excluded components when using bit-planes
+    ECSQueryBackend backend;
+    const uint64_t *requiredPlanes[ECS_QUERY_MAX_COMPONENTS];
+    const uint64_t *excludedPlanes[ECS_QUERY_MAX_COMPONENTS];
+    uint32_t excludedCount;
+    // Combined plane words starting at word planeBlockStart, bit-scanned one word per batch
+    uint64_t planeBlock[ECS_QUERY_PLANE_BLOCK];
+    uint32_t planeBlockStart;
+    uint32_t planeBlockCount;
+    uint32_t planeBlockCursor;
+    // Next driver index, or plane word, to match, and where to stop (UINT32_MAX for the end)
+    uint32_t cursor;
+    uint32_t cursorEnd;
+    // Dense indices in the driver (entity IDs for bit-planes) of the matches from the last batch
+    uint32_t batch[ECS_QUERY_BATCH];
+    uint32_t batchCount;
+    uint32_t batchCursor;
+    // Current entity and its index in the driver's array
+    uint32_t entity;
+    uint32_t index;
+    // Index ECSQueryComponentMut looked up last
+    uint32_t termIndex;
+} ECSQuery;
+
+// Start a query over the required and excluded component IDs, every required component
+// must have been registered with RegisterComponent. An invalid query yields nothing
+ECSQuery ECSQueryBegin(ECS *ecs, const uint32_t *required, uint32_t requiredCount, const uint32_t *excluded, uint32_t excludedCount);
+
+// Only visit entities whose component at position term (in the order they were given) was written at tick or later,
+// call before iterating. A sparse set query reads the ticks in order by driving from that component when it can,
+// then an unchanged entity costs one comparison, otherwise each match's tick is looked up like a component
+void ECSQueryChangedSince(ECSQuery *query, uint32_t term, uint32_t tick);
+
+// Match driver entities until a batch has at least one match, used by ECSQueryNext
+//
+// Return - False once the driver's entities run out
+bool ECSQueryFetch(ECSQuery *query);
+
+// Move on to the next matching entity, only goes through ECSQueryFetch once a batch is used up
+//
+// Return - False once every matching entity has been visited
+#define ECSQueryNext(query) (((query)->batchCursor < (query)->batchCount || ECSQueryFetch(query)) ?\
+    ((query)->index = (query)->batch[(query)->batchCursor++],\
+     (query)->entity = ((query)->driverEntities != NULL) ? (query)->driverEntities[(query)->index] : (query)->index, true) : false)
+
+// Expands to an array of component IDs and its length, for ECSQueryBegin, for example
+// ECSQueryBegin(ecs, ECSComponentList(drawRects.id, pos.id), NULL, 0)
+#define ECSComponentList(...) (const uint32_t[]){ __VA_ARGS__ }, (uint32_t)(sizeof((const uint32_t[]){ __VA_ARGS__ }) / sizeof(uint32_t))
+
+// Called by ECSParallelForEach with a query over one chunk, iterate it with ECSQueryNext as usual
+typedef void (*ECSQueryFunc)(ECSQuery *query, void *data);
+
+// Split a query that has not been iterated yet into chunks of about chunkSize entities, run fn(chunk, data)
+// over each one as a job and wait for all of them, the calling thread runs chunks too.
+// Chunks run at the same time, so fn may only write the current entity's components and must not
+// make structural changes (record them in a command buffer per chunk instead)
+void ECSParallelForEach(JobSystem *jobs, const ECSQuery *query, uint32_t chunkSize, ECSQueryFunc fn, void *data);
+
+// Index of the current entity in the array of the required component at position term
+#define ECSQueryTermIndex(query, term)\
+    (((term) == (query)->driverTerm) ? (query)->index :\
+        ECSSparsePage((query)->entityToIndex[term][(query)->entity / ECS_SPARSE_PAGE_SIZE])[(query)->entity % ECS_SPARSE_PAGE_SIZE])
+
+// Get the current entity's component for the required component at position term (in the order they were given),
+// the lookup is done here so only the components a system reads cost anything
+#define ECSQueryComponent(query, type, term) (&((type *)(query)->data[term])[ECSQueryTermIndex(query, term)])
+
+// Get the current entity's component to write to, stamping it with the query's change tick.
+// Only ask for it once the system knows it is going to write, so unchanged values stay unchanged
+#define ECSQueryComponentMut(query, type, term)\
+    ((query)->termIndex = ECSQueryTermIndex(query, term), (query)->changed[term][(query)->termIndex] = (query)->tick,\
+     &((type *)(query)->data[term])[(query)->termIndex])
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
+
+
+///////////////////////////////////////
+/// ECS Command Buffers ///////////////
+///////////////////////////////////////
+
+typedef enum ECSCommandType
+{
+    ECS_COMMAND_ADD_COMPONENT = 0,
+    ECS_COMMAND_REMOVE_COMPONENT = 1,
+    ECS_COMMAND_REMOVE_ENTITY = 2
+} ECSCommandType;
+
+typedef struct ECSCommand
+{
+    ECSCommandType type;
+    // Handle of the entity when the command was recorded, the command is not applied
+    // if the entity has been removed (and maybe its ID reused) by playback
+    EntityHandle entity;
+    uint32_t componentID;
+    // Where an added component's value starts in the buffer's values
+    uint32_t valueOffset;
+} ECSCommand;
+
+DynamicArrayDefine(ECSCommands, ECSCommand);
+DynamicArrayDefine(ECSCommandValues, unsigned char);
+
+// Records structural changes while queries are iterating, so no dense array shifts under them,
+// and applies them together at a sync point with ECSCommandBufferPlayback.
+// ECSCommandCreateEntity hands out the ID right away, an entity without components is in no query,
+// so later commands in the same buffer can refer to it.
+// Commands keep the entity's handle, an entity removed between recording and playback is skipped
+// instead of its ID (or whatever entity has it by then) getting the command.
+// The buffer grows on its own arena, which must not be cleared or rewound while the buffer is in use,
+// after the first few playbacks it stops growing
+typedef struct ECSCommandBuffer
+{
+    ECS *ecs;
+    Arena *arena;
+    ECSCommands commands;
+    // Values of added components, copied in when recorded
+    ECSCommandValues values;
+} ECSCommandBuffer;
+
+// Set up an empty command buffer for ecs, nothing is pushed onto arena until the first command
+void ECSCommandBufferInit(ECSCommandBuffer *buffer, ECS *ecs, Arena *arena);
+
+// Create an entity/ID now, its components can be added through the buffer
+//
+// Return - uint32_t entity ID
+uint32_t ECSCommandCreateEntity(ECSCommandBuffer *buffer);
+
+// Record giving an entity a component, value (the component's valueSize bytes) is copied into the buffer,
+// NULL leaves the value as it is. Like AddComponent, if the entity already has the component by playback
+// its value is overwritten
+//
+// Return - Boolean for success or failure, fails if the entity is not alive
+bool ECSCommandAddComponent(ECSCommandBuffer *buffer, uint32_t entity, uint32_t componentID, const void *value);
+
+// Record taking a component away from an entity, as ECSRemoveComponent
+//
+// Return - Boolean for success or failure, fails if the entity is not alive
+bool ECSCommandRemoveComponent(ECSCommandBuffer *buffer, uint32_t entity, uint32_t componentID);
+
+// Record removing an entity and all of its components
+//
+// Return - Boolean for success or failure, fails if the entity is not alive
+bool ECSCommandRemoveEntity(ECSCommandBuffer *buffer, uint32_t entity);
+
+// Apply every recorded command and empty the buffer. Component commands are sorted by component ID,
+// keeping the order they were recorded in for each component, and every component's commands are applied
+// in one pass with its dense array grown once. Entity removals go last, so other commands on an entity
+// removed in the same batch do not fail
+//
+// Return - Boolean for success or failure, false if any command could not be applied,
+//          including commands for entities removed since they were recorded
+bool ECSCommandBufferPlayback(ECSCommandBuffer *buffer);
+
 ///////////////////////////////////////
 ///////////////////////////////////////
 ///////////////////////////////////////
@@ -215,46 +546,93 @@ bool UnassociateComponent(uint32_t entity, ECS *ecs, uint32_t componentID);
 /// ECS Usage Macros //////////////////
 ///////////////////////////////////////
 
+#ifndef ECSComponents
+// Gets the array of ComponentDicts, indexed by component ID
+#define ECSComponents(ecsptr) ArenaRelPtr(ComponentDict, (ecsptr)->components)
+#endif
+
 #ifndef RegisterComponent
-// Register component with the ECS, allocates the array AND sets the ID given by ECS
+// Register component with the ECS, allocates the array AND sets the ID given by ECS,
+// the array is tagged "components.<componentType>" in the arena's stats
 #define RegisterComponent(ecsptr, arena, componentSet, componentType){\
-    componentSet.set = PushArray(arena, componentType, ecsptr->entities.maxEntities);\
+    componentSet.set = PushArrayTagged(arena, componentType, ecsptr->entities.maxEntities, "components." #componentType);\
     componentSet.id = ecsptr->currentComponents++;\
+    ArenaRelSet(ECSComponents(ecsptr)[componentSet.id].data, componentSet.set);\
+    ECSComponents(ecsptr)[componentSet.id].valueSize = sizeof(componentType);\
+    ECSComponents(ecsptr)[componentSet.id].valueAlign = alignof(componentType);\
+}
+#endif
+
+#ifndef BindComponent
+// Point a component set at the array a component was registered with, for an ECS
+// that was not set up in this run, such as one loaded with ArenaLoadImage
+#define BindComponent(ecsptr, componentSet, componentID){\
+    componentSet.id = componentID;\
+    componentSet.set = ArenaRelPtr(void, ECSComponents(ecsptr)[componentID].data);\
 }
 #endif
 
 #ifndef AddComponent
-// Associate component with entity in ECS, add data to appropriate index in array
+// Associate component with entity in ECS, add data to appropriate index in array and stamp it as changed
 #define AddComponent(entity, componentSet, ecsptr, data) {\
     AssociateComponent(entity, ecsptr, componentSet.id);\
-    componentSet.set[GetEntityIndex(ecsptr, entity, componentSet.id)] = data;\
+    componentSet.set[ECSMarkChanged(ecsptr, entity, componentSet.id)] = data;\
 }
 #endif
 
+#ifndef GetComponentMut
+// Gets a pointer to an entity's component to write to, stamped with the current change tick
+#define GetComponentMut(ecsptr, componentSet, entity) (&(componentSet).set[ECSMarkChanged(ecsptr, entity, (componentSet).id)])
+#endif
+
 #ifndef RemoveComponent
-// Unassociate component with entity in ECS, remove data from approprivate index in array
-#define RemoveComponent(componentSet, ecsptr, entity) {\
-    do {\
-        uint32_t removed = ecs->components[componentSet.id].entityToIndex[entity];\
-        uint32_t last = ecs->components[componentSet.id].size - 1;\
-        componentSet.set[removed] = componentSet.set[last];\
-    } while(0);\
+// Unassociate component with entity in ECS, its data is swapped out of the array along with it
+#define RemoveComponent(componentSet, ecsptr, entity) ECSRemoveComponent(entity, ecsptr, componentSet.id)
+#endif
+
+#ifndef DeferAddComponent
+// Record associating component with entity in a command buffer, data is copied into the buffer
+#define DeferAddComponent(entity, componentSet, buffer, data) {\
+    __typeof__(*componentSet.set) deferredValue = data;\
+    ECSCommandAddComponent(buffer, entity, componentSet.id, &deferredValue);\
 }
 #endif
 
+#ifndef DeferRemoveComponent
+// Record unassociating component with entity in a command buffer, its data goes with it on playback
+#define DeferRemoveComponent(componentSet, buffer, entity) ECSCommandRemoveComponent(buffer, entity, componentSet.id)
+#endif
+
 #ifndef GetEntityID
 // Gets ID of entity for given index in component array
-#define GetEntityID(ecsptr, componentIndex, componentID) ecsptr->components[componentID].indexToEntity[componentIndex]
+#define GetEntityID(ecsptr, componentIndex, componentID) ArenaRelPtr(uint32_t, ECSComponents(ecsptr)[componentID].indexToEntity)[componentIndex]
+#endif
+
+#ifndef ECSSparsePage
+// Gets the page of indices a page table entry refers to, entries are never 0 so there is no NULL check
+#define ECSSparsePage(rel) ((uint32_t *)((unsigned char *)&(rel) + (rel)))
+#endif
+
+#ifndef ComponentDictIndex
+// Gets index in a ComponentDict's component array for an entity ID, UINT32_MAX if it is not there
+#define ComponentDictIndex(dict, entityID)\
+    ECSSparsePage(ArenaRelPtr(ArenaRel, (dict)->entityToIndex)[(entityID) / ECS_SPARSE_PAGE_SIZE])[(entityID) % ECS_SPARSE_PAGE_SIZE]
 #endif
 
 #ifndef GetEntityIndex
-// Gets index in component array for given entity and component IDs
-#define GetEntityIndex(ecsptr, entityID, componentID) ecsptr->components[componentID].entityToIndex[entityID]
+// Gets index in component array for given entity and component IDs, UINT32_MAX if the entity does not have it
+#define GetEntityIndex(ecsptr, entityID, componentID) ComponentDictIndex(&ECSComponents(ecsptr)[componentID], entityID)
+#endif
+
+#ifndef ECSBitPlane
+// Gets the bit-plane of a component, only valid once bit-planes are enabled
+#define ECSBitPlane(ecsptr, componentID) (ArenaRelPtr(uint64_t, (ecsptr)->bitPlanes) + (uint64_t)(componentID) * (ecsptr)->planeWords)
 #endif
 
 #ifndef GetEntitySignature
-// Gets Bitset signature for a given entity ID 
-#define GetEntitySignature(ecsptr, entityID) ecsptr->entities.eSignatures[entityID]
+// Gets the signature words for a given entity ID
+#define GetEntitySignature(ecsptr, entityID)\
+    (ArenaRelPtr(uint64_t, (ecsptr)->entities.eSignatures) + (uint64_t)(entityID) * (ecsptr)->entities.signatureWords)
 #endif
 
 ///////////////////////////////////////
@@ -3,13 +3,17 @@
 
 #include <stdint.h>
 #include "../include/arena.h"
+#include "../include/pool.h"
 
+// Longest strValue that is kept, including the terminator, longer strings are cut off
 #define EVENT_VALUE_SIZE 128
 
 typedef struct Event
 {
     uint32_t id;
     char *strValue;
+    // Bytes allocated for strValue from the event pool's string pool
+    uint32_t strSize;
     uint32_t intValue;
 } Event;
 
@@ -25,6 +29,7 @@ typedef struct EventPool
     uint32_t maxEvents;
     uint32_t numEvents;
     EventHashmap IDtoIndices; // Hashmap using buckets that associates event IDs with indices in the event array
+    Pool strings; // strValue storage, sized to each string and released by EventPoolIterate
 } EventPool;
 
 // Initialized event pool with default values and given max size,
@@ -32,20 +37,20 @@ typedef struct EventPool
 bool EventPoolInit(EventPool *events, Arena *arena, uint32_t maxEvents);
 
 // Publishes an event onto the event pool queue, uses arguments to format new event,
-// strvalue size limit set at EVENT_VALUE_SIZE defined at the top of event.h
+// strValue is copied into a block sized to fit it, up to EVENT_VALUE_SIZE defined at the top of event.h
 void EventPoolPublish(EventPool *events, uint32_t eventID, char *strValue, uint32_t intValue);
 
 // Intended for use at end of frame, swaps current events with queued events,
 // so the old events are overwritten and the queued events are processed next frame
 void EventPoolIterate(EventPool *events);
 
-// Subscribes to an event type, searching the current events array
-// for the subscribed event ID
+// Subscribes to an event type, returning the indices in the current events array
+// of every event published with the subscribed event ID
 //
-// Fow now, duplicate event types are ignored
-// This can be changed if/when multiple events with the same ID need to be handled
-// 
-// Returns -1 when event could not be found
+// The returned array belongs to the event pool and is only valid until the next EventPoolIterate,
+// nothing is allocated so there is nothing to free
+//
+// Returns NULL when event could not be found
 uint32_t *EventPoolSubscribe(EventPool *events, uint32_t eventID);
 
 #endif
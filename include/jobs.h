@@ -0,0 +1,108 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdalign.h>
+#include "../include/arena.h"
+#include "../include/platform.h"
+
+///////////////////////////////////////
+/// Job System ////////////////////////
+///////////////////////////////////////
+
+// Work-stealing job system. Every thread has its own deque of jobs, it pushes and pops jobs at
+// the bottom of it, and threads that run out of jobs steal from the top of another thread's deque.
+// Jobs count down a JobCounter when they finish, JobWait on a counter is the fence for a group of jobs,
+// and the waiting thread runs jobs until it reaches 0 instead of sleeping.
+// Only the thread that called JobSystemInit and the job system's own worker threads may add or wait on jobs
+
+// Jobs one thread can have waiting in its deque, a power of two. A thread adding a job to a full deque runs it right away
+#define JOB_QUEUE_SIZE 4096
+
+// Threads a job system can have, the thread that called JobSystemInit included
+#define JOB_MAX_THREADS 64
+
+// Times an idle worker looks for a job to steal before it goes to sleep until the next job is added
+#define JOB_IDLE_SPINS 64
+
+// Runs over the range begin to end of whatever data points to
+typedef void (*JobFunc)(void *data, uint32_t begin, uint32_t end);
+
+// Jobs added with a counter and not finished yet
+typedef struct JobCounter
+{
+    uint32_t pending;
+} JobCounter;
+
+typedef struct Job
+{
+    JobFunc func;
+    void *data;
+    uint32_t begin;
+    uint32_t end;
+    JobCounter *counter;
+    // Set once the job has been taken off a deque, its slot in the job pool is not reused until then
+    uint32_t taken;
+} Job;
+
+// Chase-Lev deque of pointers into the owning thread's job pool, bottom is only written by the owner
+typedef struct JobQueue
+{
+    alignas(64) int64_t top;
+    alignas(64) int64_t bottom;
+    Job *jobs[JOB_QUEUE_SIZE];
+} JobQueue;
+
+struct JobSystem;
+
+typedef struct JobThread
+{
+    struct JobSystem *system;
+    uint32_t index;
+    PlatformThread thread;
+    JobQueue queue;
+    // Jobs this thread added, handed out round-robin
+    Job pool[JOB_QUEUE_SIZE];
+    uint32_t nextJob;
+    // State of the xorshift picking which thread to steal from
+    uint32_t random;
+} JobThread;
+
+// Must stay where it is (not be moved or go out of scope) until JobSystemRelease, its threads point back at it
+typedef struct JobSystem
+{
+    // threads[0] is the thread that called JobSystemInit, the rest are workers
+    JobThread *threads;
+    uint32_t threadCount;
+    // Workers asleep or about to be, each one is woken by one post of wake
+    uint32_t sleeping;
+    PlatformSemaphore wake;
+    bool quit;
+} JobSystem;
+
+// Set up a job system with workerCount worker threads, everything is allocated on arena.
+// The calling thread becomes the job system's first thread, with 0 workers every job runs on it
+//
+// Return - Boolean for success or failure, fails if workerCount + 1 is above JOB_MAX_THREADS
+//          or a thread could not be started
+bool JobSystemInit(JobSystem *jobs, Arena *arena, uint32_t workerCount);
+
+// Stop and join the worker threads, every job must have finished
+void JobSystemRelease(JobSystem *jobs);
+
+// Add a job calling func(data, begin, end), counter (can be NULL) counts it until it has run
+void JobAdd(JobSystem *jobs, JobFunc func, void *data, uint32_t begin, uint32_t end, JobCounter *counter);
+
+// Run jobs until every job added with counter has finished
+void JobWait(JobSystem *jobs, JobCounter *counter);
+
+// Split begin to end into ranges of at most chunkSize, run func over each one as a job and wait for all of them.
+// A range that fits in one chunk is run on the calling thread without adding any jobs
+void JobParallelFor(JobSystem *jobs, JobFunc func, void *data, uint32_t begin, uint32_t end, uint32_t chunkSize);
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
+
+#endif
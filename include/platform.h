@@ -0,0 +1,119 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+///////////////////////////////////////
+// Virtual Memory /////////////////////
+///////////////////////////////////////
+
+// Size of one huge page, huge page reservations are aligned to this
+// and should only ever be committed in multiples of it
+#define PLATFORM_HUGE_PAGE_SIZE (2ULL * 1024ULL * 1024ULL)
+
+// How the OS should back a reservation once it is committed
+typedef enum PlatformPageMode
+{
+    PLATFORM_PAGES_DEFAULT = 0,
+    // Ask for transparent huge pages (madvise), silently uses regular pages if unavailable
+    PLATFORM_PAGES_HUGE = 1,
+    // Ask for explicit hugetlbfs pages, falls back to PLATFORM_PAGES_HUGE if the pool is too small
+    PLATFORM_PAGES_HUGE_EXPLICIT = 2
+} PlatformPageMode;
+
+// Get the size of a regular OS page in bytes, queried from the OS once and cached
+uint64_t PlatformPageSize();
+
+// Reserve a range of address space without backing it with memory
+//
+// Return - Base of the reserved range, NULL on failure
+void *PlatformReserve(uint64_t size, PlatformPageMode mode);
+
+// Make a page aligned range inside of a reservation readable and writable
+//
+// Return - Boolean for success or failure
+bool PlatformCommit(void *ptr, uint64_t size);
+
+// Give a committed range back to the OS, it stays reserved and reads as zero once committed again
+//
+// Return - Boolean for success or failure
+bool PlatformDecommit(void *ptr, uint64_t size);
+
+// Fault in a committed range ahead of time so first touches do not page fault,
+// uses MADV_POPULATE_WRITE where available and touches every page otherwise
+void PlatformPrefault(void *ptr, uint64_t size);
+
+// Fill the first size bytes of a reservation with the start of the file at path and make them
+// readable and writable. Where possible the file is mapped copy-on-write so pages are only read
+// once touched and writes stay private, otherwise the range is committed and read into.
+//
+// Return - Boolean for success or failure
+bool PlatformMapFile(void *ptr, uint64_t size, const char *path);
+
+// Release an entire reservation, size must match the size it was reserved with
+void PlatformRelease(void *ptr, uint64_t size);
+
+// Bytes of the process's memory that are currently resident, 0 where the OS can not tell
+uint64_t PlatformResidentBytes();
+
+///////////////////////////////////////
+// Threads ////////////////////////////
+///////////////////////////////////////
+
+typedef void (*PlatformThreadFunc)(void *arg);
+
+// OS thread, must stay alive (not be moved or go out of scope) until PlatformThreadJoin
+typedef struct PlatformThread
+{
+    uintptr_t handle;
+    PlatformThreadFunc func;
+    void *arg;
+} PlatformThread;
+
+// Start a thread running func(arg)
+//
+// Return - Boolean for success or failure
+bool PlatformThreadCreate(PlatformThread *thread, PlatformThreadFunc func, void *arg);
+
+// Wait for a thread to finish
+void PlatformThreadJoin(PlatformThread *thread);
+
+// Give up the rest of the calling thread's time slice
+void PlatformThreadYield();
+
+// Number of logical processors available to the process
+uint32_t PlatformProcessorCount();
+
+// Counting semaphore for parking threads that have nothing to do
+typedef struct PlatformSemaphore
+{
+    uintptr_t handle;
+} PlatformSemaphore;
+
+// Create a semaphore with a count of 0
+//
+// Return - Boolean for success or failure
+bool PlatformSemaphoreCreate(PlatformSemaphore *semaphore);
+
+// Wait until the count is above 0, then take one from it
+void PlatformSemaphoreWait(PlatformSemaphore *semaphore);
+
+// Add count to the semaphore, waking up to count waiting threads
+void PlatformSemaphorePost(PlatformSemaphore *semaphore, uint32_t count);
+
+// Destroy a semaphore no thread is waiting on
+void PlatformSemaphoreDestroy(PlatformSemaphore *semaphore);
+
+///////////////////////////////////////
+// Timing /////////////////////////////
+///////////////////////////////////////
+
+// Monotonic clock in nanoseconds, only meaningful as a difference
+uint64_t PlatformTimeNs();
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
+
+#endif
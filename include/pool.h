@@ -0,0 +1,60 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/arena.h"
+
+///////////////////////////////////////
+// Pool Allocator /////////////////////
+///////////////////////////////////////
+
+// Size classes are powers of 2 from POOL_MIN_SIZE up to POOL_MAX_SIZE bytes
+#define POOL_CLASS_COUNT 8
+#define POOL_MIN_SIZE 16
+#define POOL_MAX_SIZE (POOL_MIN_SIZE << (POOL_CLASS_COUNT - 1))
+
+// Bytes pushed onto the arena whenever a size class runs out of blocks
+#define POOL_SLAB_SIZE (64 * 1024)
+
+// Freed blocks store the link to the next free block inside themselves
+typedef struct PoolFreeNode
+{
+    struct PoolFreeNode *next;
+} PoolFreeNode;
+
+// Size-class pool allocator for objects that are allocated and freed one at a time,
+// slabs are carved out of an arena so nothing ever goes through malloc.
+// Memory is only returned to the arena all at once, by clearing or deallocating the arena.
+typedef struct Pool
+{
+    Arena *arena;
+    PoolFreeNode *freeLists[POOL_CLASS_COUNT];
+    // Unused tail of the newest slab of each size class
+    unsigned char *slabCursor[POOL_CLASS_COUNT];
+    unsigned char *slabEnd[POOL_CLASS_COUNT];
+    // Blocks currently handed out per size class
+    uint32_t liveBlocks[POOL_CLASS_COUNT];
+} Pool;
+
+// Initialize a pool that takes its slabs from the given arena
+//
+// Return - Boolean for success or failure
+bool PoolInit(Pool *pool, Arena *arena);
+
+// Get a block of at least size bytes in O(1)
+//
+// Return - Pointer to the block, NULL if size is above POOL_MAX_SIZE or the arena is out of memory
+void *PoolAlloc(Pool *pool, uint64_t size);
+
+// Give a block back in O(1), size must be the size it was allocated with (any size in the same class works)
+void PoolFree(Pool *pool, void *ptr, uint64_t size);
+
+// Forget every block at once, only call after clearing or popping the pool's slabs off the arena
+void PoolReset(Pool *pool);
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/ecs.h"
+#include "../include/jobs.h"
+
+///////////////////////////////////////
+/// System Scheduler //////////////////
+///////////////////////////////////////
+
+// Runs a tick's systems as jobs on a job system. Every system declares what it reads and writes,
+// each tick the scheduler orders every two systems that conflict the way they were added,
+// and systems that do not conflict run at the same time.
+// The result is the same as running the systems one after another in the order they were added
+
+// Systems a scheduler can hold, each one's successors fit in one uint64_t
+#define SCHEDULER_MAX_SYSTEMS 64
+
+// Returned by SchedulerAddSystem when the system could not be added
+#define SCHEDULER_NONE UINT32_MAX
+
+typedef void (*SystemFunc)(void *context);
+
+// What a system touches while it runs. Components are bits by component ID,
+// events and resources are bits by event ID and by a number the game picks for each resource
+// (the tilemap, a command buffer, a scratch arena ...), both below 64.
+// Publishing appends to the event pool's one event array, so any two systems that publish are ordered.
+// A structural system creates or removes entities or components directly, and is ordered with every other system
+typedef struct SystemAccess
+{
+    uint64_t reads[ECS_SIGNATURE_MAX_WORDS];
+    uint64_t writes[ECS_SIGNATURE_MAX_WORDS];
+    uint64_t eventReads;
+    uint64_t eventWrites;
+    uint64_t resourceReads;
+    uint64_t resourceWrites;
+    bool structural;
+} SystemAccess;
+
+typedef struct SchedulerSystem
+{
+    const char *name;
+    SystemFunc func;
+    void *context;
+    SystemAccess access;
+    // When the system last started and finished, from PlatformTimeNs
+    uint64_t startNs;
+    uint64_t endNs;
+} SchedulerSystem;
+
+// Must stay where it is (not be moved or go out of scope) while SchedulerRun is running, its jobs point back at it
+typedef struct Scheduler
+{
+    JobSystem *jobs;
+    SchedulerSystem systems[SCHEDULER_MAX_SYSTEMS];
+    uint32_t systemCount;
+
+    // The tick's dependency DAG, bit j of successors[i] is set if system j waits on system i.
+    // Edges only go from earlier added systems to later ones
+    uint64_t successors[SCHEDULER_MAX_SYSTEMS];
+    uint64_t predecessors[SCHEDULER_MAX_SYSTEMS];
+    // Predecessors each system is still waiting on this tick
+    uint32_t pending[SCHEDULER_MAX_SYSTEMS];
+    // Systems added as jobs and not finished yet this tick
+    JobCounter running;
+
+    // Longest chain of dependent systems in the last tick by how long each one ran,
+    // the tick can not finish faster than criticalPathNs on any number of threads
+    uint32_t criticalPath[SCHEDULER_MAX_SYSTEMS];
+    uint32_t criticalPathCount;
+    uint64_t criticalPathNs;
+    // Time spent in systems summed up, and from the start of SchedulerRun to the end, in the last tick
+    uint64_t workNs;
+    uint64_t wallNs;
+} Scheduler;
+
+// Set up a scheduler without any systems that runs them on jobs, with a job system without workers
+// every system runs on the thread calling SchedulerRun
+void SchedulerInit(Scheduler *scheduler, JobSystem *jobs);
+
+// Add a system that calls func(context) every tick, name is kept as is and only used for reporting
+//
+// Return - The system's index, SCHEDULER_NONE if there are already SCHEDULER_MAX_SYSTEMS
+uint32_t SchedulerAddSystem(Scheduler *scheduler, const char *name, SystemFunc func, void *context, SystemAccess access);
+
+// Run every system once, returns when all of them have finished. Only the thread that set up the job system may call it
+void SchedulerRun(Scheduler *scheduler);
+
+// Declare access to a component through its component set
+#define SystemReads(access, componentSet) BITSET((access).reads, (componentSet).id)
+#define SystemWrites(access, componentSet) BITSET((access).writes, (componentSet).id)
+
+// Declare subscribing to and publishing an event ID
+#define SystemSubscribes(access, eventID) ((access).eventReads |= (uint64_t)1 << (eventID))
+#define SystemPublishes(access, eventID) ((access).eventWrites |= (uint64_t)1 << (eventID))
+
+// Declare access to a resource outside of the ECS
+#define SystemReadsResource(access, resource) ((access).resourceReads |= (uint64_t)1 << (resource))
+#define SystemWritesResource(access, resource) ((access).resourceWrites |= (uint64_t)1 << (resource))
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
+
+#endif
@@ -0,0 +1,51 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/alloccount.h"
+
+static uint64_t allocCount = 0;
+
+#ifdef CGAME_COUNT_ALLOCS
+
+// Provided by the linker when linking with --wrap=malloc,--wrap=calloc,--wrap=realloc
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+// Raylib's audio thread can allocate as well, so the counter is bumped atomically
+void *__wrap_malloc(size_t size)
+{
+    __atomic_fetch_add(&allocCount, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    __atomic_fetch_add(&allocCount, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    __atomic_fetch_add(&allocCount, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+bool AllocCountEnabled()
+{
+    return true;
+}
+
+#else
+
+bool AllocCountEnabled()
+{
+    return false;
+}
+
+#endif
+
+uint64_t AllocCount()
+{
+    return __atomic_load_n(&allocCount, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,293 @@
+#include <string.h>
+#include <stdalign.h>
+#include "../include/archetype.h"
+
+// Chunks are aligned to this, component types can not ask for more
+#define CHUNK_ALIGN 64
+
+static uint32_t AlignOffset(uint32_t offset, uint32_t align)
+{
+    return (offset + align - 1) & ~(align - 1);
+}
+
+// Places the entity ID column and every component column of an archetype for capacity entities
+//
+// Return - Bytes of a chunk the layout needs
+static uint32_t ArchetypeLayout(ArchetypeStore *store, Archetype *archetype, uint32_t capacity)
+{
+    uint32_t offset = AlignOffset(sizeof(ArchetypeChunk), alignof(uint32_t));
+    archetype->entityColumn = offset;
+    offset += capacity * sizeof(uint32_t);
+
+    for (uint32_t c = 0; c < ARCHETYPE_MAX_COMPONENTS; c++)
+    {
+        archetype->columns[c] = ARCHETYPE_NONE;
+        if (c >= store->componentCount || !(archetype->mask & ArchetypeBit(c))) continue;
+
+        offset = AlignOffset(offset, store->componentAligns[c]);
+        archetype->columns[c] = offset;
+        offset += capacity * store->componentSizes[c];
+    }
+
+    return offset;
+}
+
+// Finds the archetype with exactly mask, adding it if there is none yet.
+// Adding one can move the archetype array, so pointers to archetypes have to be fetched again after
+//
+// Return - Index of the archetype, ARCHETYPE_NONE on failure
+static uint32_t ArchetypeFind(ArchetypeStore *store, ArchetypeMask mask)
+{
+    for (uint32_t i = 0; i < store->archetypes.len; i++)
+    {
+        if (store->archetypes.values[i].mask == mask) return i;
+    }
+
+    Archetype archetype;
+    archetype.mask = mask;
+    archetype.count = 0;
+    DynamicArrayInit(archetype.chunks, store->arena);
+
+    // Start from what fits ignoring alignment padding and back off until the padding fits too
+    uint32_t rowBytes = sizeof(uint32_t);
+    for (uint32_t c = 0; c < store->componentCount; c++)
+    {
+        if (mask & ArchetypeBit(c)) rowBytes += store->componentSizes[c];
+    }
+    uint32_t capacity = (ARCHETYPE_CHUNK_SIZE - sizeof(ArchetypeChunk)) / rowBytes;
+    while (capacity > 0 && ArchetypeLayout(store, &archetype, capacity) > ARCHETYPE_CHUNK_SIZE) capacity--;
+    if (capacity == 0) return ARCHETYPE_NONE;
+    archetype.capacity = capacity;
+
+    if (!DynamicArrayPush(store->archetypes, archetype)) return ARCHETYPE_NONE;
+
+    return store->archetypes.len - 1;
+}
+
+// Address of a component (or with ARCHETYPE_MAX_COMPONENTS, the entity ID) of a row in an archetype
+static unsigned char *ArchetypeCell(ArchetypeStore *store, Archetype *archetype, uint32_t row, uint32_t componentID)
+{
+    ArchetypeChunk *chunk = archetype->chunks.values[row / archetype->capacity];
+    uint32_t index = row % archetype->capacity;
+
+    if (componentID == ARCHETYPE_MAX_COMPONENTS)
+    {
+        return (unsigned char *)chunk + archetype->entityColumn + index * sizeof(uint32_t);
+    }
+
+    return (unsigned char *)chunk + archetype->columns[componentID] + index * store->componentSizes[componentID];
+}
+
+// Adds a row for entity to the end of an archetype, its components are left as they are
+//
+// Return - The row, ARCHETYPE_NONE on failure
+static uint32_t ArchetypeAddRow(ArchetypeStore *store, Archetype *archetype, uint32_t entity)
+{
+    if (archetype->count == archetype->chunks.len * archetype->capacity)
+    {
+        ArchetypeChunk *chunk = store->freeChunks;
+        if (chunk != NULL) store->freeChunks = chunk->nextFree;
+        else chunk = ArenaPushTagged(store->arena, ARCHETYPE_CHUNK_SIZE, CHUNK_ALIGN, "archetype.chunks");
+        if (chunk == NULL) return ARCHETYPE_NONE;
+
+        chunk->count = 0;
+        if (!DynamicArrayPush(archetype->chunks, chunk))
+        {
+            chunk->nextFree = store->freeChunks;
+            store->freeChunks = chunk;
+            return ARCHETYPE_NONE;
+        }
+    }
+
+    uint32_t row = archetype->count++;
+    archetype->chunks.values[row / archetype->capacity]->count++;
+    memcpy(ArchetypeCell(store, archetype, row, ARCHETYPE_MAX_COMPONENTS), &entity, sizeof(entity));
+
+    return row;
+}
+
+// Removes a row from an archetype by moving its last row into it, an emptied last chunk goes to the free list
+static void ArchetypeRemoveRow(ArchetypeStore *store, Archetype *archetype, uint32_t row)
+{
+    uint32_t last = archetype->count - 1;
+    if (row != last)
+    {
+        uint32_t movedEntity;
+        memcpy(&movedEntity, ArchetypeCell(store, archetype, last, ARCHETYPE_MAX_COMPONENTS), sizeof(movedEntity));
+        memcpy(ArchetypeCell(store, archetype, row, ARCHETYPE_MAX_COMPONENTS), &movedEntity, sizeof(movedEntity));
+
+        for (uint32_t c = 0; c < store->componentCount; c++)
+        {
+            if (!(archetype->mask & ArchetypeBit(c))) continue;
+            memcpy(ArchetypeCell(store, archetype, row, c), ArchetypeCell(store, archetype, last, c), store->componentSizes[c]);
+        }
+
+        store->entityRow[movedEntity] = row;
+    }
+
+    ArchetypeChunk *lastChunk = archetype->chunks.values[last / archetype->capacity];
+    lastChunk->count--;
+    archetype->count--;
+
+    if (lastChunk->count == 0)
+    {
+        DynamicArrayPop(archetype->chunks, 1);
+        lastChunk->nextFree = store->freeChunks;
+        store->freeChunks = lastChunk;
+    }
+}
+
+// Moves an entity into the archetype at dstIndex, keeping every component both archetypes have
+// and zeroing the ones only the destination has
+//
+// Return - Boolean for success or failure
+static bool ArchetypeMoveEntity(ArchetypeStore *store, uint32_t entity, uint32_t dstIndex)
+{
+    Archetype *dst = &store->archetypes.values[dstIndex];
+    uint32_t dstRow = ArchetypeAddRow(store, dst, entity);
+    if (dstRow == ARCHETYPE_NONE) return false;
+
+    uint32_t srcRow = store->entityRow[entity];
+    Archetype *src = (srcRow != ARCHETYPE_NONE) ? &store->archetypes.values[store->entityArchetype[entity]] : NULL;
+    ArchetypeMask srcMask = (src != NULL) ? src->mask : 0;
+
+    for (uint32_t c = 0; c < store->componentCount; c++)
+    {
+        if (!(dst->mask & ArchetypeBit(c))) continue;
+
+        unsigned char *cell = ArchetypeCell(store, dst, dstRow, c);
+        if (srcMask & ArchetypeBit(c)) memcpy(cell, ArchetypeCell(store, src, srcRow, c), store->componentSizes[c]);
+        else memset(cell, 0, store->componentSizes[c]);
+    }
+
+    if (src != NULL) ArchetypeRemoveRow(store, src, srcRow);
+
+    store->entityArchetype[entity] = dstIndex;
+    store->entityRow[entity] = dstRow;
+
+    return true;
+}
+
+bool ArchetypeStoreInit(ArchetypeStore *store, Arena *arena, uint32_t maxEntities)
+{
+    store->arena = arena;
+    store->maxEntities = maxEntities;
+    store->componentCount = 0;
+    store->freeChunks = NULL;
+    DynamicArrayInit(store->archetypes, arena);
+
+    const char *previousTag = ArenaSetTag(arena, "archetype.entities");
+    store->entityArchetype = PushArray(arena, uint32_t, maxEntities);
+    store->entityRow = PushArray(arena, uint32_t, maxEntities);
+    ArenaSetTag(arena, previousTag);
+    if (store->entityArchetype == NULL || store->entityRow == NULL) return false;
+
+    memset(store->entityArchetype, 0xFF, sizeof(uint32_t) * maxEntities);
+    memset(store->entityRow, 0xFF, sizeof(uint32_t) * maxEntities);
+
+    return true;
+}
+
+uint32_t ArchetypeRegisterComponent(ArchetypeStore *store, uint32_t size, uint32_t align)
+{
+    if (store->componentCount >= ARCHETYPE_MAX_COMPONENTS || align > CHUNK_ALIGN) return ARCHETYPE_NONE;
+    if (size + sizeof(uint32_t) + sizeof(ArchetypeChunk) + align > ARCHETYPE_CHUNK_SIZE) return ARCHETYPE_NONE;
+
+    store->componentSizes[store->componentCount] = size;
+    store->componentAligns[store->componentCount] = align;
+
+    return store->componentCount++;
+}
+
+bool ArchetypeAddComponent(ArchetypeStore *store, uint32_t entity, uint32_t componentID, const void *data)
+{
+    if (entity >= store->maxEntities || componentID >= store->componentCount) return false;
+
+    ArchetypeMask mask = 0;
+    if (store->entityRow[entity] != ARCHETYPE_NONE) mask = store->archetypes.values[store->entityArchetype[entity]].mask;
+
+    if (!(mask & ArchetypeBit(componentID)))
+    {
+        uint32_t dstIndex = ArchetypeFind(store, mask | ArchetypeBit(componentID));
+        if (dstIndex == ARCHETYPE_NONE || !ArchetypeMoveEntity(store, entity, dstIndex)) return false;
+    }
+
+    if (data != NULL)
+    {
+        Archetype *archetype = &store->archetypes.values[store->entityArchetype[entity]];
+        memcpy(ArchetypeCell(store, archetype, store->entityRow[entity], componentID), data, store->componentSizes[componentID]);
+    }
+
+    return true;
+}
+
+bool ArchetypeRemoveComponent(ArchetypeStore *store, uint32_t entity, uint32_t componentID)
+{
+    if (entity >= store->maxEntities || componentID >= store->componentCount) return false;
+    if (store->entityRow[entity] == ARCHETYPE_NONE) return false;
+
+    ArchetypeMask mask = store->archetypes.values[store->entityArchetype[entity]].mask;
+    if (!(mask & ArchetypeBit(componentID))) return false;
+
+    mask &= ~ArchetypeBit(componentID);
+    if (mask == 0) return ArchetypeRemoveEntity(store, entity);
+
+    uint32_t dstIndex = ArchetypeFind(store, mask);
+    if (dstIndex == ARCHETYPE_NONE) return false;
+
+    return ArchetypeMoveEntity(store, entity, dstIndex);
+}
+
+bool ArchetypeRemoveEntity(ArchetypeStore *store, uint32_t entity)
+{
+    if (entity >= store->maxEntities || store->entityRow[entity] == ARCHETYPE_NONE) return false;
+
+    ArchetypeRemoveRow(store, &store->archetypes.values[store->entityArchetype[entity]], store->entityRow[entity]);
+    store->entityArchetype[entity] = ARCHETYPE_NONE;
+    store->entityRow[entity] = ARCHETYPE_NONE;
+
+    return true;
+}
+
+void *ArchetypeGetComponent(ArchetypeStore *store, uint32_t entity, uint32_t componentID)
+{
+    if (entity >= store->maxEntities || componentID >= store->componentCount) return NULL;
+    if (store->entityRow[entity] == ARCHETYPE_NONE) return NULL;
+
+    Archetype *archetype = &store->archetypes.values[store->entityArchetype[entity]];
+    if (!(archetype->mask & ArchetypeBit(componentID))) return NULL;
+
+    return ArchetypeCell(store, archetype, store->entityRow[entity], componentID);
+}
+
+ArchetypeQuery ArchetypeQueryBegin(ArchetypeStore *store, ArchetypeMask required, ArchetypeMask excluded)
+{
+    return (ArchetypeQuery){ store, required, excluded, 0, 0, 0, NULL };
+}
+
+// chunk is the next chunk of the current archetype to visit
+bool ArchetypeQueryNext(ArchetypeQuery *query)
+{
+    Archetypes *archetypes = &query->store->archetypes;
+    while (query->archetype < archetypes->len)
+    {
+        Archetype *archetype = &archetypes->values[query->archetype];
+        bool matches = (archetype->mask & query->required) == query->required && !(archetype->mask & query->excluded);
+
+        if (matches && query->chunk < archetype->chunks.len)
+        {
+            ArchetypeChunk *chunk = archetype->chunks.values[query->chunk++];
+            query->count = chunk->count;
+            query->entities = (uint32_t *)((unsigned char *)chunk + archetype->entityColumn);
+            return true;
+        }
+
+        query->archetype++;
+        query->chunk = 0;
+    }
+
+    query->count = 0;
+    query->entities = NULL;
+
+    return false;
+}
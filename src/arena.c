@@ -1,12 +1,28 @@
 #include <stdlib.h>
 #include <string.h>
-#include <memoryapi.h>
-#include "../include/windows_utils.h"
+#include "../include/platform.h"
 #include "../include/arena.h"
 
-// 16gb virtual alloc max
+// 64gb virtual alloc max
 #define VIRTUAL_ALLOC_SIZE 64000000000
 
+// default commit granularity, large enough that building a world
+// does not make a commit syscall for every few pushes
+#define DEFAULT_COMMIT_SIZE (64 * 1024)
+
+// default size of each block of a chained arena
+#define DEFAULT_BLOCK_SIZE (4 * 1024 * 1024)
+
+// space kept at the start of every chained block for its header
+#define BLOCK_HEADER_SIZE 64
+
+// identifies files written by ArenaSaveImage, the version changes whenever the layout does
+#define IMAGE_MAGIC "CGARENA\0"
+#define IMAGE_VERSION 1
+#define IMAGE_NO_ROOT UINT64_MAX
+
+_Static_assert(sizeof(ArenaBlock) <= BLOCK_HEADER_SIZE, "ArenaBlock must fit in BLOCK_HEADER_SIZE");
+
 // default alignment
 #define DEFAULT_ALIGN (2*(sizeof(void *)))
 
@@ -14,6 +30,12 @@
 // Arena Allocator ////////////////////
 ///////////////////////////////////////
 
+// Per-thread scratch arenas, see ArenaScratchBegin
+static _Thread_local Arena *scratchArenas[ARENA_SCRATCH_COUNT];
+
+// Parameters used by ArenaAlloc, see ArenaSetDefaultParams
+static ArenaParams defaultParams = { 0 };
+
 // Validates if the input (memory address) is a power of 2
 static bool IsPowOfTwo(uintptr_t x)
 {
@@ -38,23 +60,322 @@ static uintptr_t AlignPtr(uintptr_t ptr, uint64_t align)
     return ptr;
 }
 
+// Rounds size up to the next multiple of granularity, granularity must be a power of 2
+static uint64_t AlignSize(uint64_t size, uint64_t granularity)
+{
+    return (size + granularity - 1) & ~(granularity - 1);
+}
+
+// Commits enough memory for the first size bytes of the arena to be usable,
+// rounded up to the arena's commit granularity so later pushes can skip the syscall
+static bool ArenaCommit(Arena *arena, uint64_t size)
+{
+    uint64_t target = AlignSize(size, arena->commitSize);
+    if (target > arena->reserved) target = arena->reserved;
+    if (target <= arena->committed) return true;
+
+    uint64_t commitBytes = target - arena->committed;
+    if (!PlatformCommit(arena->arena + arena->committed, commitBytes)) return false;
+    if (arena->flags & ARENA_PREFAULT) PlatformPrefault(arena->arena + arena->committed, commitBytes);
+
+    // Concurrent pushes read committed without holding the commit lock
+    __atomic_store_n(&arena->committed, target, __ATOMIC_RELEASE);
+    arena->pages = target / PlatformPageSize();
+
+    return true;
+}
+
+// Page mode the arena's memory was reserved with
+static PlatformPageMode ArenaPageMode(Arena *arena)
+{
+    if (arena->flags & ARENA_HUGE_PAGES_EXPLICIT) return PLATFORM_PAGES_HUGE_EXPLICIT;
+    if (arena->flags & ARENA_HUGE_PAGES) return PLATFORM_PAGES_HUGE;
+
+    return PLATFORM_PAGES_DEFAULT;
+}
+
+// Position in the current block (or the whole reservation) that the arena's offset is at
+static uint64_t ArenaLocalOffset(Arena *arena)
+{
+    if (arena->block == NULL) return arena->offset;
+
+    return arena->offset - arena->blockBase + BLOCK_HEADER_SIZE;
+}
+
+// Makes block the one the arena pushes onto, saving how much of the previous block was committed
+static void ArenaEnterBlock(Arena *arena, ArenaBlock *block)
+{
+    if (arena->block != NULL) arena->block->committed = arena->committed;
+
+    arena->block = block;
+    arena->arena = (unsigned char *)block;
+    arena->reserved = block->size;
+    arena->committed = block->committed;
+    arena->pages = block->committed / PlatformPageSize();
+    arena->blockBase = block->base;
+}
+
+// Reserves a block with room for at least minSize bytes after its header and commits the header
+static ArenaBlock *ArenaReserveBlock(Arena *arena, uint64_t minSize)
+{
+    uint64_t pageSize = (ArenaPageMode(arena) != PLATFORM_PAGES_DEFAULT) ? PLATFORM_HUGE_PAGE_SIZE : PlatformPageSize();
+    uint64_t size = AlignSize(minSize + BLOCK_HEADER_SIZE, pageSize);
+    if (size < arena->blockSize) size = arena->blockSize;
+
+    ArenaBlock *block = PlatformReserve(size, ArenaPageMode(arena));
+    if (block == NULL) return NULL;
+
+    uint64_t headerCommit = AlignSize(BLOCK_HEADER_SIZE, arena->commitSize);
+    if (headerCommit > size) headerCommit = size;
+    if (!PlatformCommit(block, headerCommit))
+    {
+        PlatformRelease(block, size);
+        return NULL;
+    }
+
+    block->prev = NULL;
+    block->base = 0;
+    block->size = size;
+    block->committed = headerCommit;
+
+    return block;
+}
+
+// Moves a chained arena onto a fresh block that can fit allocSize at the given alignment
+static bool ArenaNextBlock(Arena *arena, uint64_t allocSize, uint64_t align)
+{
+    uint64_t needed = allocSize + align;
+
+    // Reuse the most recently emptied block if it is big enough
+    ArenaBlock *block = arena->spareBlocks;
+    if (block != NULL && block->size - BLOCK_HEADER_SIZE >= needed)
+    {
+        arena->spareBlocks = block->prev;
+    }
+    else
+    {
+        block = ArenaReserveBlock(arena, needed);
+        if (block == NULL) return false;
+
+        // The size limit covers every block in the chain, spares included
+        uint64_t chainSize = block->size;
+        for (ArenaBlock *prev = arena->block; prev != NULL; prev = prev->prev) chainSize += prev->size;
+        for (ArenaBlock *spare = arena->spareBlocks; spare != NULL; spare = spare->prev) chainSize += spare->size;
+        if (arena->sizeLimit != 0 && chainSize > arena->sizeLimit)
+        {
+            PlatformRelease(block, block->size);
+            return false;
+        }
+    }
+
+    block->prev = arena->block;
+    block->base = arena->offset;
+    ArenaEnterBlock(arena, block);
+
+    return true;
+}
+
+// Releases a list of blocks linked through prev
+static void ArenaReleaseBlocks(ArenaBlock *block)
+{
+    while (block != NULL)
+    {
+        ArenaBlock *prev = block->prev;
+        PlatformRelease(block, block->size);
+        block = prev;
+    }
+}
+
+// Folds the offset into the high water mark and the frame's peak. ARENA_CONCURRENT pushes leave both alone,
+// so this also runs before the offset moves back and wherever they are read
+static void ArenaTrackPeak(Arena *arena)
+{
+    if (arena->offset > arena->framePeak) arena->framePeak = arena->offset;
+    if (arena->offset > arena->highWater) arena->highWater = arena->offset;
+}
+
+// Moves the arena's offset back to position, stepping back through chained blocks as needed.
+// Emptied blocks are kept as spares so filling the arena again does not reserve, see ArenaDecommit
+static void ArenaRewind(Arena *arena, uint64_t position)
+{
+    ArenaTrackPeak(arena);
+
+    while (arena->block != NULL && arena->block->prev != NULL && position < arena->blockBase)
+    {
+        ArenaBlock *emptied = arena->block;
+        ArenaEnterBlock(arena, emptied->prev);
+
+        emptied->prev = arena->spareBlocks;
+        arena->spareBlocks = emptied;
+    }
+
+    arena->offset = position;
+}
+
+// Finds the index of tag in the arena's tag table, adding it if there is room
+static uint32_t ArenaTagIndex(Arena *arena, const char *tag)
+{
+    if (tag == NULL) return 0;
+
+    for (uint32_t i = 0; i < arena->tagCount; i++)
+    {
+        if (arena->tags[i].tag == tag || strcmp(arena->tags[i].tag, tag) == 0) return i;
+    }
+
+    if (arena->tagCount >= ARENA_MAX_TAGS) return 0;
+
+    arena->tags[arena->tagCount] = (ArenaTagStats){ tag, 0, 0 };
+    return arena->tagCount++;
+}
+
+// Lock-free push for ARENA_CONCURRENT arenas, claims the worst case of allocSize plus alignment
+// padding with one fetch-add, so at most align - 1 bytes are wasted per push
+static void *ArenaPushConcurrent(Arena *arena, uint64_t allocSize, uint64_t align, uint32_t tag)
+{
+    if (!IsPowOfTwo(align)) return NULL;
+
+    __atomic_fetch_add(&arena->pushCount, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&arena->paddingBytes, align - 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&arena->tags[tag].pushes, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&arena->tags[tag].bytes, allocSize, __ATOMIC_RELAXED);
+
+    uint64_t claimed = __atomic_fetch_add(&arena->offset, allocSize + align - 1, __ATOMIC_RELAXED);
+    uint64_t arenaOffset = AlignPtr((uintptr_t)arena->arena + claimed, align) - (uintptr_t)arena->arena;
+    uint64_t newOffset = arenaOffset + allocSize;
+    if (newOffset > arena->reserved) return NULL;
+
+    if (newOffset > __atomic_load_n(&arena->committed, __ATOMIC_ACQUIRE))
+    {
+        // Only the thread holding the lock commits, everyone else waits and re-checks
+        while (__atomic_test_and_set(&arena->commitLock, __ATOMIC_ACQUIRE))
+        {
+            PlatformThreadYield();
+        }
+
+        bool committed = (newOffset <= arena->committed) || ArenaCommit(arena, newOffset);
+        __atomic_clear(&arena->commitLock, __ATOMIC_RELEASE);
+
+        if (!committed) return NULL;
+    }
+
+    return &arena->arena[arenaOffset];
+}
+
 // Allocate and set up an arena
 Arena *ArenaAlloc()
 {
+    return ArenaAllocParams(defaultParams);
+}
+
+void ArenaSetDefaultParams(ArenaParams params)
+{
+    defaultParams = params;
+}
+
+// Allocate and set up an arena, reserving address space according to params.
+// Returns NULL if the address space could not be reserved.
+Arena *ArenaAllocParams(ArenaParams params)
+{
+    // Arenas that do not ask for a size follow the process defaults, such as chaining blocks
+    if (params.reserveSize == 0 && params.blockSize == 0)
+    {
+        params.reserveSize = defaultParams.reserveSize;
+        params.blockSize = defaultParams.blockSize;
+        params.flags |= defaultParams.flags & ARENA_CHAINED;
+    }
+
+    // Concurrent pushes need one contiguous range
+    if ((params.flags & ARENA_CHAINED) && (params.flags & ARENA_CONCURRENT)) return NULL;
+
+    PlatformPageMode mode = PLATFORM_PAGES_DEFAULT;
+    if (params.flags & ARENA_HUGE_PAGES) mode = PLATFORM_PAGES_HUGE;
+    if (params.flags & ARENA_HUGE_PAGES_EXPLICIT) mode = PLATFORM_PAGES_HUGE_EXPLICIT;
+
+    // Huge page arenas can only be committed in whole huge pages
+    uint64_t pageSize = (mode != PLATFORM_PAGES_DEFAULT) ? PLATFORM_HUGE_PAGE_SIZE : PlatformPageSize();
+    uint64_t defaultCommit = (mode != PLATFORM_PAGES_DEFAULT) ? PLATFORM_HUGE_PAGE_SIZE : DEFAULT_COMMIT_SIZE;
+
+    uint64_t reserveSize = params.reserveSize != 0 ? params.reserveSize : VIRTUAL_ALLOC_SIZE;
+    reserveSize = AlignSize(reserveSize, pageSize);
+
+    uint64_t commitSize = params.commitSize != 0 ? params.commitSize : defaultCommit;
+    commitSize = AlignSize(commitSize, pageSize);
+    // Granularity has to be a power of 2 for AlignSize
+    while (!IsPowOfTwo(commitSize)) commitSize += pageSize;
+
     Arena *arena = malloc(sizeof(*arena));
-    arena->arena = VirtualAlloc(NULL, VIRTUAL_ALLOC_SIZE, MEM_RESERVE, PAGE_READWRITE);
+    if (arena == NULL) return NULL;
+
     arena->offset = 0;
     arena->pages = 0;
+    arena->committed = 0;
+    arena->reserved = reserveSize;
+    arena->commitSize = commitSize;
+    arena->flags = params.flags;
+
+    arena->block = NULL;
+    arena->spareBlocks = NULL;
+    arena->blockBase = 0;
+    arena->blockSize = 0;
+    arena->sizeLimit = 0;
+
+    if (params.flags & ARENA_CHAINED)
+    {
+        arena->blockSize = AlignSize(params.blockSize != 0 ? params.blockSize : DEFAULT_BLOCK_SIZE, pageSize);
+        arena->sizeLimit = params.reserveSize;
+        if (arena->sizeLimit != 0 && arena->blockSize > arena->sizeLimit)
+        {
+            arena->blockSize = AlignSize(arena->sizeLimit, pageSize);
+        }
+
+        ArenaBlock *first = ArenaReserveBlock(arena, 0);
+        if (first == NULL)
+        {
+            free(arena);
+            return NULL;
+        }
+        ArenaEnterBlock(arena, first);
+    }
+    else
+    {
+        arena->arena = PlatformReserve(reserveSize, mode);
+        if (arena->arena == NULL)
+        {
+            free(arena);
+            return NULL;
+        }
+    }
+
+    arena->commitLock = false;
+    arena->decommitThreshold = 0;
+    arena->decommitFrames = 0;
+    arena->framesBelow = 0;
+    arena->framePeak = 0;
+
+    arena->highWater = 0;
+    arena->pushCount = 0;
+    arena->paddingBytes = 0;
+    arena->tags[0] = (ArenaTagStats){ "untagged", 0, 0 };
+    arena->tagCount = 1;
+    arena->currentTag = 0;
 
     return arena;
 }
 
-// Frees ALL of the memory an arena points to
+// Frees ALL of the memory an arena points to, as well as the arena itself
 void ArenaDealloc(Arena *arena)
 {
-    VirtualFree(arena->arena, 0, MEM_RELEASE);
-    arena->offset = 0;
-    arena->pages = 0;
+    if (arena->block != NULL)
+    {
+        ArenaReleaseBlocks(arena->block);
+        ArenaReleaseBlocks(arena->spareBlocks);
+    }
+    else
+    {
+        PlatformRelease(arena->arena, arena->reserved);
+    }
+
+    free(arena);
 }
 
 // Arena allocation with an alignment argument, if the default alignment 
@@ -62,23 +383,46 @@ void ArenaDealloc(Arena *arena)
 // Returns NULL if there is not enough room in the allocator.
 void *ArenaPush(Arena *arena, uint64_t allocSize, uint64_t align)
 {
+    return ArenaPushTagged(arena, allocSize, align, NULL);
+}
+
+// Same as ArenaPush, but accounted under tag when it is not NULL
+void *ArenaPushTagged(Arena *arena, uint64_t allocSize, uint64_t align, const char *tag)
+{
+    uint32_t tagIndex = (tag == NULL) ? arena->currentTag : ArenaTagIndex(arena, tag);
+    if (arena->flags & ARENA_CONCURRENT) return ArenaPushConcurrent(arena, allocSize, align, tagIndex);
+
     // Get lowest unused space in arena
-    uintptr_t unusedAddress = (uintptr_t)arena->arena + (uintptr_t)arena->offset;
+    uint64_t localOffset = ArenaLocalOffset(arena);
+    uintptr_t unusedAddress = (uintptr_t)arena->arena + (uintptr_t)localOffset;
     // Align that position, and get offset from start of arena
     uintptr_t arenaOffset = AlignPtr(unusedAddress, align) - (uintptr_t)arena->arena;
 
-    int32_t pageSize = GetPageSize();
+    // Bad alignment underflows to a huge offset and fails here as well
+    uint64_t newOffset = arenaOffset + allocSize;
+    if (arenaOffset > arena->reserved || newOffset > arena->reserved)
+    {
+        // Chained arenas continue in a new block instead
+        if (arena->block == NULL || !IsPowOfTwo(align)) return NULL;
+        if (!ArenaNextBlock(arena, allocSize, align)) return NULL;
+
+        localOffset = ArenaLocalOffset(arena);
+        arenaOffset = AlignPtr((uintptr_t)arena->arena + localOffset, align) - (uintptr_t)arena->arena;
+        newOffset = arenaOffset + allocSize;
+    }
+
+    // Commit pages past the end of the committed range if this allocation needs them
+    if (newOffset > arena->committed && !ArenaCommit(arena, newOffset)) return NULL;
 
     // Get ptr and change offset to reflect space being allocated
     void *ptr = &arena->arena[arenaOffset];
-    int32_t nextPageDistance = (arenaOffset + allocSize) - (arena->pages * pageSize);
-    if (nextPageDistance > 0)
-    {
-        int32_t newPages = (nextPageDistance / pageSize) + 1;
-        arena->pages += newPages;
-        VirtualAlloc(ptr, newPages * pageSize, MEM_COMMIT, PAGE_READWRITE);
-    }
-    arena->offset = arenaOffset + allocSize;
+    arena->paddingBytes += arenaOffset - localOffset;
+    arena->offset += newOffset - localOffset;
+    ArenaTrackPeak(arena);
+
+    arena->pushCount++;
+    arena->tags[tagIndex].pushes++;
+    arena->tags[tagIndex].bytes += allocSize;
 
     return ptr;
 }
@@ -86,19 +430,445 @@ void *ArenaPush(Arena *arena, uint64_t allocSize, uint64_t align)
 void *ArenaPushZero(Arena *arena, uint64_t allocSize, uint64_t align)
 {
     void *ptr = ArenaPush(arena, allocSize, align);
+    if (ptr == NULL) return NULL;
     // Set memory to 0
     memset(ptr, 0, allocSize);
     return ptr;
 }
 
+void *ArenaTop(Arena *arena)
+{
+    return arena->arena + ArenaLocalOffset(arena);
+}
+
 void ArenaPop(Arena *arena, uint64_t popSize)
 {
-    arena->offset -= popSize;
+    ArenaRewind(arena, arena->offset - popSize);
 }
 
 void ArenaClear(Arena *arena)
 {
-    arena->offset = 0;
+    ArenaRewind(arena, 0);
+}
+
+bool ArenaDecommit(Arena *arena, uint64_t keepSize)
+{
+    if (keepSize < arena->offset) keepSize = arena->offset;
+
+    // Chained arenas only shrink their current block, and drop their spare blocks
+    if (arena->block != NULL)
+    {
+        ArenaReleaseBlocks(arena->spareBlocks);
+        arena->spareBlocks = NULL;
+
+        keepSize = keepSize - arena->blockBase + BLOCK_HEADER_SIZE;
+    }
+
+    uint64_t keep = AlignSize(keepSize, arena->commitSize);
+    if (keep >= arena->committed) return true;
+
+    if (!PlatformDecommit(arena->arena + keep, arena->committed - keep)) return false;
+
+    arena->committed = keep;
+    arena->pages = keep / PlatformPageSize();
+
+    return true;
+}
+
+void ArenaSetDecommitPolicy(Arena *arena, uint64_t threshold, uint32_t frames)
+{
+    arena->decommitThreshold = threshold;
+    arena->decommitFrames = frames;
+    arena->framesBelow = 0;
+}
+
+void ArenaFrameEnd(Arena *arena)
+{
+    ArenaTrackPeak(arena);
+    uint64_t peak = arena->framePeak;
+    arena->framePeak = arena->offset;
+
+    if (arena->decommitFrames == 0) return;
+
+    // Any frame above the threshold restarts the count
+    if (peak > arena->decommitThreshold)
+    {
+        arena->framesBelow = 0;
+        return;
+    }
+
+    if (arena->framesBelow < arena->decommitFrames) arena->framesBelow++;
+    if (arena->framesBelow >= arena->decommitFrames && arena->committed > AlignSize(arena->decommitThreshold, arena->commitSize))
+    {
+        ArenaDecommit(arena, arena->decommitThreshold);
+    }
+}
+
+const char *ArenaSetTag(Arena *arena, const char *tag)
+{
+    const char *previous = arena->currentTag == 0 ? NULL : arena->tags[arena->currentTag].tag;
+    arena->currentTag = ArenaTagIndex(arena, tag);
+    return previous;
+}
+
+ArenaStats ArenaGetStats(Arena *arena)
+{
+    ArenaStats stats;
+    stats.reserved = arena->reserved;
+    stats.committed = arena->committed;
+
+    // Chained arenas add up every block behind the current one
+    if (arena->block != NULL)
+    {
+        for (ArenaBlock *block = arena->block->prev; block != NULL; block = block->prev)
+        {
+            stats.reserved += block->size;
+            stats.committed += block->committed;
+        }
+        for (ArenaBlock *block = arena->spareBlocks; block != NULL; block = block->prev)
+        {
+            stats.reserved += block->size;
+            stats.committed += block->committed;
+        }
+    }
+
+    ArenaTrackPeak(arena);
+    stats.used = arena->offset;
+    stats.highWater = arena->highWater;
+    stats.pushCount = arena->pushCount;
+    stats.paddingBytes = arena->paddingBytes;
+    stats.tags = arena->tags;
+    stats.tagCount = arena->tagCount;
+
+    return stats;
+}
+
+void ArenaWriteStatsCSVHeader(FILE *file)
+{
+    fprintf(file, "arena,tag,pushes,bytes,padding,used,high_water,committed,reserved\n");
+}
+
+void ArenaWriteStatsCSV(Arena *arena, const char *name, FILE *file)
+{
+    ArenaStats stats = ArenaGetStats(arena);
+
+    fprintf(file, "%s,total,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n", name,
+            (unsigned long long)stats.pushCount, (unsigned long long)stats.used, (unsigned long long)stats.paddingBytes,
+            (unsigned long long)stats.used, (unsigned long long)stats.highWater,
+            (unsigned long long)stats.committed, (unsigned long long)stats.reserved);
+
+    // Tag rows only know what was pushed under them, not how much of it is still live
+    for (uint32_t i = 0; i < stats.tagCount; i++)
+    {
+        fprintf(file, "%s,%s,%llu,%llu,,,,,\n", name, stats.tags[i].tag,
+                (unsigned long long)stats.tags[i].pushes, (unsigned long long)stats.tags[i].bytes);
+    }
+}
+
+ArenaTemp ArenaTempBegin(Arena *arena)
+{
+    return (ArenaTemp){ arena, arena->offset };
+}
+
+// Temps must be ended in reverse order of being started,
+// ending an outer temp also releases everything from the inner ones
+void ArenaTempEnd(ArenaTemp temp)
+{
+    ArenaRewind(temp.arena, temp.offset);
+}
+
+// Copies size bytes from src to dst one page at a time, skipping pages in the first
+// compareSize bytes that dst already matches, so unchanged memory is only read and never written
+//
+// Return - Number of pages copied
+static uint64_t CopyDirtyPages(unsigned char *dst, const unsigned char *src, uint64_t size, uint64_t compareSize)
+{
+    uint64_t pageSize = PlatformPageSize();
+    uint64_t dirtyPages = 0;
+    for (uint64_t i = 0; i < size; i += pageSize)
+    {
+        uint64_t length = (size - i < pageSize) ? size - i : pageSize;
+        if (i + length <= compareSize && memcmp(dst + i, src + i, length) == 0) continue;
+
+        memcpy(dst + i, src + i, length);
+        dirtyPages++;
+    }
+
+    return dirtyPages;
+}
+
+// Whether block is one of the chained arena's blocks, current or spare
+static bool ArenaOwnsBlock(Arena *arena, ArenaBlock *block)
+{
+    for (ArenaBlock *owned = arena->block; owned != NULL; owned = owned->prev)
+    {
+        if (owned == block) return true;
+    }
+    for (ArenaBlock *owned = arena->spareBlocks; owned != NULL; owned = owned->prev)
+    {
+        if (owned == block) return true;
+    }
+
+    return false;
+}
+
+// Commits the first size bytes of one of the arena's blocks, like ArenaCommit but without entering the block
+static bool ArenaCommitBlock(Arena *arena, ArenaBlock *block, uint64_t size)
+{
+    if (block == arena->block) return ArenaCommit(arena, size);
+
+    uint64_t target = AlignSize(size, arena->commitSize);
+    if (target > block->size) target = block->size;
+    if (target <= block->committed) return true;
+
+    uint64_t commitBytes = target - block->committed;
+    if (!PlatformCommit((unsigned char *)block + block->committed, commitBytes)) return false;
+    if (arena->flags & ARENA_PREFAULT) PlatformPrefault((unsigned char *)block + block->committed, commitBytes);
+    block->committed = target;
+
+    return true;
+}
+
+// Takes block out of the arena's spare list, it must be in it
+static void ArenaUnlinkSpare(Arena *arena, ArenaBlock *block)
+{
+    ArenaBlock **link = &arena->spareBlocks;
+    while (*link != block) link = &(*link)->prev;
+    *link = block->prev;
+}
+
+// Checkpoints of chained arenas store the data of every block back to back,
+// so offsets into the checkpoint data match the arena's own offsets
+bool ArenaSnapshot(Arena *arena, ArenaCheckpoint *checkpoint)
+{
+    uint64_t offset = arena->offset;
+
+    // Only a checkpoint of this same arena holds anything worth comparing against
+    uint64_t compareSize = (checkpoint->arena == arena) ? checkpoint->offset : 0;
+    if (compareSize > offset) compareSize = offset;
+
+    if (offset > checkpoint->capacity)
+    {
+        uint64_t capacity = checkpoint->capacity * 2;
+        if (capacity < offset) capacity = offset;
+
+        unsigned char *data = realloc(checkpoint->data, capacity);
+        if (data == NULL) return false;
+        checkpoint->data = data;
+        checkpoint->capacity = capacity;
+    }
+
+    if (arena->block == NULL)
+    {
+        checkpoint->blockCount = 0;
+        checkpoint->dirtyPages = CopyDirtyPages(checkpoint->data, arena->arena, offset, compareSize);
+    }
+    else
+    {
+        uint32_t blockCount = 0;
+        for (ArenaBlock *block = arena->block; block != NULL; block = block->prev) blockCount++;
+
+        if (blockCount > checkpoint->blockCapacity)
+        {
+            ArenaCheckpointBlock *blocks = realloc(checkpoint->blocks, blockCount * sizeof(*blocks));
+            if (blocks == NULL) return false;
+            checkpoint->blocks = blocks;
+            checkpoint->blockCapacity = blockCount;
+        }
+
+        // Walk back from the newest block, each block ends where the one after it begins
+        checkpoint->dirtyPages = 0;
+        uint64_t end = offset;
+        uint32_t index = blockCount;
+        for (ArenaBlock *block = arena->block; block != NULL; block = block->prev)
+        {
+            uint64_t base = (block == arena->block) ? arena->blockBase : block->base;
+            unsigned char *src = (unsigned char *)block + BLOCK_HEADER_SIZE;
+            uint64_t blockCompare = (compareSize > base) ? compareSize - base : 0;
+
+            checkpoint->dirtyPages += CopyDirtyPages(checkpoint->data + base, src, end - base, blockCompare);
+            checkpoint->blocks[--index] = (ArenaCheckpointBlock){ block, base };
+            end = base;
+        }
+        checkpoint->blockCount = blockCount;
+    }
+
+    checkpoint->arena = arena;
+    checkpoint->offset = offset;
+
+    return true;
+}
+
+bool ArenaRestore(Arena *arena, const ArenaCheckpoint *checkpoint)
+{
+    if (checkpoint->arena != arena) return false;
+
+    ArenaTrackPeak(arena);
+
+    if (arena->block == NULL)
+    {
+        if (checkpoint->offset > arena->committed && !ArenaCommit(arena, checkpoint->offset)) return false;
+        memcpy(arena->arena, checkpoint->data, checkpoint->offset);
+    }
+    else
+    {
+        // Everything that can fail is done before the block list is touched, so a failed restore changes nothing.
+        // Committing more of a block than is in use does not change what the arena holds
+        for (uint32_t i = 0; i < checkpoint->blockCount; i++)
+        {
+            ArenaCheckpointBlock saved = checkpoint->blocks[i];
+            uint64_t end = (i + 1 < checkpoint->blockCount) ? checkpoint->blocks[i + 1].base : checkpoint->offset;
+            uint64_t localEnd = end - saved.base + BLOCK_HEADER_SIZE;
+
+            if (!ArenaOwnsBlock(arena, saved.block) || localEnd > saved.block->size) return false;
+            if (!ArenaCommitBlock(arena, saved.block, localEnd)) return false;
+        }
+
+        // Turn every block into a spare, then chain the checkpoint's blocks back up in order
+        arena->block->committed = arena->committed;
+        ArenaBlock *block = arena->block;
+        while (block != NULL)
+        {
+            ArenaBlock *prev = block->prev;
+            block->prev = arena->spareBlocks;
+            arena->spareBlocks = block;
+            block = prev;
+        }
+        arena->block = NULL;
+
+        for (uint32_t i = 0; i < checkpoint->blockCount; i++)
+        {
+            ArenaCheckpointBlock saved = checkpoint->blocks[i];
+            uint64_t end = (i + 1 < checkpoint->blockCount) ? checkpoint->blocks[i + 1].base : checkpoint->offset;
+
+            ArenaUnlinkSpare(arena, saved.block);
+            saved.block->prev = arena->block;
+            saved.block->base = saved.base;
+            ArenaEnterBlock(arena, saved.block);
+            arena->offset = saved.base;
+
+            memcpy((unsigned char *)saved.block + BLOCK_HEADER_SIZE, checkpoint->data + saved.base, end - saved.base);
+        }
+    }
+
+    arena->offset = checkpoint->offset;
+    ArenaTrackPeak(arena);
+
+    return true;
+}
+
+void ArenaCheckpointFree(ArenaCheckpoint *checkpoint)
+{
+    free(checkpoint->data);
+    free(checkpoint->blocks);
+    *checkpoint = (ArenaCheckpoint){ 0 };
+}
+
+// Written after an image's data rather than before it, so the data starts at the beginning
+// of the file where it can be mapped straight into an arena
+typedef struct ArenaImageTrailer
+{
+    char magic[8];
+    uint64_t version;
+    uint64_t size;
+    // Offset of the root object, IMAGE_NO_ROOT if none was saved
+    uint64_t root;
+} ArenaImageTrailer;
+
+bool ArenaSaveImage(Arena *arena, const char *path, void *root)
+{
+    if (arena->block != NULL) return false;
+
+    ArenaImageTrailer trailer;
+    memcpy(trailer.magic, IMAGE_MAGIC, sizeof(trailer.magic));
+    trailer.version = IMAGE_VERSION;
+    trailer.size = arena->offset;
+    trailer.root = (root != NULL) ? (uint64_t)((unsigned char *)root - arena->arena) : IMAGE_NO_ROOT;
+    if (root != NULL && trailer.root >= trailer.size) return false;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) return false;
+
+    bool written = fwrite(arena->arena, 1, trailer.size, file) == trailer.size &&
+                   fwrite(&trailer, sizeof(trailer), 1, file) == 1;
+
+    return (fclose(file) == 0) && written;
+}
+
+Arena *ArenaLoadImage(const char *path, uint64_t reserveSize, void **root)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+
+    ArenaImageTrailer trailer;
+    bool valid = fseek(file, -(long)sizeof(trailer), SEEK_END) == 0 &&
+                 fread(&trailer, sizeof(trailer), 1, file) == 1 &&
+                 memcmp(trailer.magic, IMAGE_MAGIC, sizeof(trailer.magic)) == 0 &&
+                 trailer.version == IMAGE_VERSION &&
+                 (uint64_t)ftell(file) == trailer.size + sizeof(trailer);
+    fclose(file);
+    if (!valid) return NULL;
+
+    // Reserve explicitly so the image is never split across chained blocks
+    uint64_t imagePages = AlignSize(trailer.size, PlatformPageSize());
+    if (reserveSize < imagePages) reserveSize = imagePages;
+    Arena *arena = ArenaAllocParams((ArenaParams){ .reserveSize = reserveSize });
+    if (arena == NULL) return NULL;
+
+    if (trailer.size > 0 && !PlatformMapFile(arena->arena, trailer.size, path))
+    {
+        ArenaDealloc(arena);
+        return NULL;
+    }
+
+    arena->committed = imagePages;
+    arena->pages = imagePages / PlatformPageSize();
+    arena->offset = trailer.size;
+    arena->highWater = trailer.size;
+    arena->framePeak = trailer.size;
+
+    if (root != NULL) *root = (trailer.root != IMAGE_NO_ROOT) ? arena->arena + trailer.root : NULL;
+
+    return arena;
+}
+
+// Callers pass in any arena they might be allocating their results on,
+// so a callee never rewinds memory that its caller still needs
+ArenaTemp ArenaScratchBegin(Arena **conflicts, uint32_t conflictCount)
+{
+    for (int i = 0; i < ARENA_SCRATCH_COUNT; i++)
+    {
+        if (scratchArenas[i] == NULL)
+        {
+            scratchArenas[i] = ArenaAlloc();
+            if (scratchArenas[i] == NULL) break;
+        }
+
+        bool conflicting = false;
+        for (uint32_t j = 0; j < conflictCount; j++)
+        {
+            if (conflicts[j] == scratchArenas[i])
+            {
+                conflicting = true;
+                break;
+            }
+        }
+
+        if (!conflicting) return ArenaTempBegin(scratchArenas[i]);
+    }
+
+    return (ArenaTemp){ NULL, 0 };
+}
+
+void ArenaScratchRelease()
+{
+    for (int i = 0; i < ARENA_SCRATCH_COUNT; i++)
+    {
+        if (scratchArenas[i] == NULL) continue;
+
+        ArenaDealloc(scratchArenas[i]);
+        scratchArenas[i] = NULL;
+    }
 }
 
 ///////////////////////////////////////
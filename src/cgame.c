@@ -13,6 +13,10 @@
 #include "../include/arena.h"
 #include "../include/console.h"
 #include "../include/util.h"
+#include "../include/alloccount.h"
+#include "../include/scheduler.h"
+#include "../include/jobs.h"
+#include "../include/platform.h"
 
 // TODO:
 //  Restarting the game or quitting depending on player input, upon death
@@ -47,10 +51,31 @@
 #define MAX_COMPONENTS 7
 #define MAX_EVENTS 4
 
-// Segments of the snakes body
+// The ECS and component arenas are touched by every system each tick, so they commit in 2MB steps,
+// arenas that are only as big as what is in use are faulted in up front too
+#define HOT_ARENA_COMMIT (2 * 1024 * 1024)
+
+// Scratch memory above this is given back to the OS after two seconds of ticks below it
+#define FRAME_ARENA_KEEP (256 * 1024)
+#define FRAME_ARENA_DECOMMIT_TICKS (TICKS_PER_SEC * 2)
+
+#define ARENA_STATS_FILE "arena_stats.csv"
+#define ARENA_TAG_FONT 10
+
+// Most worker threads the job system starts, fewer if there are not enough processors
+#define SYSTEM_WORKERS 3
+
+// Entities in each job syncing rectangles to positions before drawing
+#define DRAW_SYNC_CHUNK 1024
+
+// Set to a block size in bytes (0 for the default) to chain arena blocks instead
+// of reserving 64GB of address space per arena, for ulimit -v or strict overcommit
+#define ARENA_BLOCK_SIZE_ENV "CGAME_ARENA_BLOCK_SIZE"
+
+// Segments of the snakes body, kept as handles so a removed segment is never mistaken for whatever reuses its ID
 typedef struct Segments
 {
-    uint32_t *entityIDs;
+    EntityHandle *handles;
     uint32_t count;
 } Segments;
 
@@ -70,12 +95,56 @@ typedef struct Tilemap
     bool *map;
 } Tilemap;
 
+// Things outside of the ECS that systems touch, bit numbers for SystemAccess resources
+typedef enum GameResources
+{
+    RESOURCE_TILEMAP = 0,
+    RESOURCE_SEGMENTS = 1,
+    RESOURCE_COMMANDS = 2,
+    RESOURCE_FRAME_ARENA = 3,
+    RESOURCE_CONSOLE = 4
+} GameResources;
+
+// Everything the tick's systems are called with, the context of every scheduled system
+typedef struct GameSystems
+{
+    ECS *ecs;
+    EventPool *events;
+    ECSCommandBuffer *commands;
+    Arena *frameArena;
+    Console *console;
+    Tilemap board;
+    Segments *segments;
+    uint32_t snakeID;
+    uint32_t screenW;
+    uint32_t screenH;
+    DrawRectSet drawRects;
+    PositionSet positions;
+    ColliderSet colliders;
+    CollectibleSet collectibles;
+    ControllerSet controls;
+    FollowerSet followers;
+    TextSet texts;
+    // Set to false by PlayerDeathSystem
+    bool running;
+} GameSystems;
+
 int GameLoop(const int, const int);
-void DrawSystem(ECS *, DrawRectSet, TextSet, PositionSet);
-void CollectibleSystem(ECS *, EventPool *, Tilemap, uint32_t, CollectibleSet, PositionSet, ColliderSet, DrawRectSet);
+void AddGameSystems(Scheduler *, GameSystems *);
+void RunPlayerMovement(void *);
+void RunCollectible(void *);
+void RunFollow(void *);
+void RunSnakeCollide(void *);
+void RunFoodEaten(void *);
+void RunPlayerDeath(void *);
+void DrawArenaStats(const char *, Arena *, float, float, bool);
+void PlaceInitialFood(ECS *, Tilemap, uint32_t, Vector2Int, PositionSet, DrawRectSet);
+void SyncDrawRects(ECSQuery *, void *);
+void DrawSystem(ECS *, JobSystem *, DrawRectSet, TextSet, PositionSet, uint32_t *);
+void CollectibleSystem(ECS *, EventPool *, ECSCommandBuffer *, Tilemap, uint32_t, CollectibleSet, PositionSet, ColliderSet, DrawRectSet);
 void PlayerMovementSystem(ECS *, EventPool *, uint32_t, Tilemap, ControllerSet, PositionSet, ColliderSet);
 void FollowSystem(ECS *, uint32_t, Tilemap, ControllerSet, PositionSet, FollowerSet);
-void FoodEatenSystem(ECS *, EventPool *, Tilemap, uint32_t, Segments *, FollowerSet, CollectibleSet, PositionSet, DrawRectSet);
+void FoodEatenSystem(ECS *, EventPool *, ECSCommandBuffer *, Arena *, Tilemap, uint32_t, Segments *, FollowerSet, CollectibleSet, PositionSet, DrawRectSet);
 void SnakeCollideSystem(ECS *, EventPool *, uint32_t, Segments *, ColliderSet, PositionSet);
 bool PlayerDeathSystem(ECS *, EventPool *, Console *, TextSet, PositionSet, const uint32_t, const uint32_t);
 
@@ -85,6 +154,12 @@ int main(int argc, char **argv)
     const int screenW = SCREEN_WIDTH;
     const int screenH = SCREEN_HEIGHT;
 
+    const char *blockSize = getenv(ARENA_BLOCK_SIZE_ENV);
+    if (blockSize != NULL)
+    {
+        ArenaSetDefaultParams((ArenaParams){ .blockSize = strtoull(blockSize, NULL, 10), .flags = ARENA_CHAINED });
+    }
+
     srand(time(NULL));
     InitWindow(screenW, screenH, "Test Window");
     SetTargetFPS(60);
@@ -105,14 +180,18 @@ int GameLoop(const int screenW, const int screenH)
     uint32_t maxEntities = MAX_ENTITIES;
     uint32_t maxComponents = MAX_COMPONENTS;
 
-    Arena *ecsArena = ArenaAlloc();
+    ArenaParams hotArenaParams = { .commitSize = HOT_ARENA_COMMIT, .flags = ARENA_HUGE_PAGES | ARENA_PREFAULT };
+    // Not prefaulted, per-ID state and component arrays for all maxEntities IDs are pushed up front
+    // but only faulted in as entities are created and given components
+    ArenaParams ecsArenaParams = { .commitSize = HOT_ARENA_COMMIT, .flags = ARENA_HUGE_PAGES };
+    Arena *ecsArena = ArenaAllocParams(ecsArenaParams);
 
     // Initialize and allocate ECS all in the same arena,
     // tying the lifetimes of every piece of the ECS together
     ECS *ecs = PushStruct(ecsArena, ECS);
     ECSInit(ecs, ecsArena, maxEntities, maxComponents);
 
-    Arena *componentArena = ArenaAlloc();
+    Arena *componentArena = ArenaAllocParams(ecsArenaParams);
 
     // Component Initialization
     DrawRectSet drawRects;
@@ -139,18 +218,28 @@ int GameLoop(const int screenW, const int screenH)
     // General use arena initialization
     Arena *generalArena = ArenaAlloc();
 
+    // Scratch memory for systems, everything on it only lives until the end of the tick
+    Arena *frameArena = ArenaAlloc();
+    ArenaSetDecommitPolicy(frameArena, FRAME_ARENA_KEEP, FRAME_ARENA_DECOMMIT_TICKS);
+
+    // Entity spawns and removals systems ask for during a tick, applied together at the end of it.
+    // Playback empties the buffer every tick, so the arena stops growing after the first few
+    Arena *commandArena = ArenaAllocParams(hotArenaParams);
+    ECSCommandBuffer commands;
+    ECSCommandBufferInit(&commands, ecs, commandArena);
+
     // Console
-    Console console;
-    InitConsole(&console, generalArena, (Rectangle){0, 0, screenW, screenH}, 256, 256, 25, (Color){0,0,0,128}, GREEN);
-    ConsoleSetKeys(&console, KEY_UP, KEY_DOWN, KEY_C);
-    console.enabled = false;
-    //ConsoleSetOutline(&console, -25, -25, screenW/2 + 25, screenH/2 + 25, 25, DARKGRAY);
+    Console *console = PushStruct(generalArena, Console);
+    InitConsole(console, generalArena, (Rectangle){0, 0, screenW, screenH}, 256, 256, 25, (Color){0,0,0,128}, GREEN);
+    ConsoleSetKeys(console, KEY_UP, KEY_DOWN, KEY_C);
+    console->enabled = false;
+    //ConsoleSetOutline(console, -25, -25, screenW/2 + 25, screenH/2 + 25, 25, DARKGRAY);
 
     for (int i = 0; i < 30; i++)
     {
         char buff[8];
         sprintf(buff, "%d", i);
-        WriteConsole(&console, buff);
+        WriteConsole(console, buff);
     }
 
     // Board 
@@ -160,8 +249,8 @@ int GameLoop(const int screenW, const int screenH)
     board.height = BOARD_HEIGHT;
     board.cellSize = screenW / board.width;
     uint32_t boardArea = board.width * board.height;
-    board.map = PushArray(generalArena, bool, boardArea);
-    Line *backgroundGrid = PushArray(generalArena, Line, (board.width + board.height));
+    board.map = PushArrayTagged(generalArena, bool, boardArea, "game.board");
+    Line *backgroundGrid = PushArrayTagged(generalArena, Line, (board.width + board.height), "game.board");
     int lineIndex = 0;
     for (int i = 0; i < board.width; i++)
     {
@@ -187,9 +276,9 @@ int GameLoop(const int screenW, const int screenH)
     }
     
     // Events 
-    EventPool eventPool;
+    EventPool *eventPool = PushStruct(generalArena, EventPool);
     uint32_t eventTypes = MAX_EVENTS;
-    EventPoolInit(&eventPool, generalArena, eventTypes);
+    EventPoolInit(eventPool, generalArena, eventTypes);
 
     // Snake player initialization
     uint32_t snakeID = CreateEntity(ecs);
@@ -212,30 +301,48 @@ int GameLoop(const int screenW, const int screenH)
     AddComponent(snakeID, controls, ecs, ((Controller){ KEY_A, KEY_D, KEY_W, KEY_S, -1 }));
 
     // Snake follower array initialization
-    Segments segments;
-    segments.entityIDs = PushArray(generalArena, uint32_t, boardArea - 1);
-    segments.count = 0;
+    Segments *segments = PushStruct(generalArena, Segments);
+    segments->handles = PushArrayTagged(generalArena, EntityHandle, boardArea - 1, "game.segments");
+    segments->count = 0;
 
     // Initial food collectible
     uint32_t initialFood = CreateEntity(ecs);
 
-    Vector2Int foodBoardPos;
-    do
-    {
-        foodBoardPos = (Vector2Int){ rand() % board.width, rand() % board.width };
-    } while(foodBoardPos.x == startBoard.x && foodBoardPos.y == startBoard.y);
-    Vector2 foodWorldPos = 
-            { foodBoardPos.x * board.cellSize + (float)board.cellSize / 4.0f, foodBoardPos.y * board.cellSize + (float)board.cellSize / 4.0f };
-    AddComponent(initialFood, positions, ecs, ((Position){ foodWorldPos, foodBoardPos }));
+    AddComponent(initialFood, positions, ecs, ((Position){ 0 }));
 
-    Rectangle foodRect = { foodWorldPos.x, foodWorldPos.y, (float)board.cellSize / 2.0f, (float)board.cellSize / 2.0f };
+    Rectangle foodRect = { 0.0f, 0.0f, (float)board.cellSize / 2.0f, (float)board.cellSize / 2.0f };
     DrawRect foodDrawRect = { foodRect, FOOD_COLOR };
     AddComponent(initialFood, drawRects, ecs, foodDrawRect);
 
     AddComponent(initialFood, collectibles, ecs, ((Collectible){ FoodEaten }));
+    PlaceInitialFood(ecs, board, initialFood, startBoard, positions, drawRects);
+
+    // Everything a match changes lives in these arenas, so restarting restores
+    // this snapshot of the fresh match instead of building it again from scratch
+    Arena *matchArenas[] = { ecsArena, componentArena, generalArena };
+    const uint32_t matchArenaCount = sizeof(matchArenas) / sizeof(matchArenas[0]);
+    ArenaCheckpoint matchStart[sizeof(matchArenas) / sizeof(matchArenas[0])] = { 0 };
+    bool canRestore = true;
+    for (int i = 0; i < matchArenaCount; i++) canRestore = canRestore && ArenaSnapshot(matchArenas[i], &matchStart[i]);
+
+    // Systems run on the scheduler, systems that touch the same things run in the order they are added
+    GameSystems game = { ecs, eventPool, &commands, frameArena, console, board, segments, snakeID, screenW, screenH,
+                         drawRects, positions, colliders, collectibles, controls, followers, texts, true };
+    uint32_t processors = PlatformProcessorCount();
+    uint32_t workers = (processors - 1 < SYSTEM_WORKERS) ? processors - 1 : SYSTEM_WORKERS;
+    // Worker threads for the scheduler and parallel queries, on an arena of its own since the threads outlive match restores
+    Arena *jobArena = ArenaAlloc();
+    JobSystem jobs;
+    if (!JobSystemInit(&jobs, jobArena, workers)) JobSystemInit(&jobs, jobArena, 0);
+    Scheduler scheduler;
+    SchedulerInit(&scheduler, &jobs);
+    AddGameSystems(&scheduler, &game);
 
     // Gameplay loop
+    uint32_t drawSyncTick = 0;
     bool runSystems = true;
+    bool showArenaTags = false;
+    uint64_t tickAllocs = 0;
     float tickTimer = 0.0f;
     float tickMaxTime = 1.0f / (float)TICKS_PER_SEC;
     while(!WindowShouldClose())
@@ -246,29 +353,49 @@ int GameLoop(const int screenW, const int screenH)
         if (runSystems && tickTimer >= tickMaxTime)
         {
             tickTimer -= tickMaxTime;
+            uint64_t allocsBefore = AllocCount();
 
-            // Systems
-            PlayerMovementSystem(ecs, &eventPool, snakeID, board, controls, positions, colliders);
-            CollectibleSystem(ecs, &eventPool, board, snakeID, collectibles, positions, colliders, drawRects);
-            FollowSystem(ecs, snakeID, board, controls, positions, followers);
-            SnakeCollideSystem(ecs, &eventPool, snakeID, &segments, colliders, positions);
+            // Systems and event handlers
+            SchedulerRun(&scheduler);
+            runSystems = game.running;
 
-            // Event Handlers
-            FoodEatenSystem(ecs, &eventPool, board, snakeID, &segments, followers, collectibles, positions, drawRects);
-            runSystems = PlayerDeathSystem(ecs, &eventPool, &console, texts, positions, screenW, screenH);
+            // Structural changes are applied once every system is done iterating,
+            // then the event pool and scratch memory are cleared at end of tick
+            ECSCommandBufferPlayback(&commands);
+            EventPoolIterate(eventPool);
+            ArenaClear(frameArena);
+            ArenaFrameEnd(frameArena);
 
-            // Clear event pool at end of tick
-            EventPoolIterate(&eventPool);
+            // Steady state ticks should never touch the heap
+            tickAllocs = AllocCount() - allocsBefore;
         }
 
         if (!runSystems)
         {
-            if (IsKeyPressed(KEY_R))
+            if (IsKeyPressed(KEY_R) && canRestore)
+            {
+                for (int i = 0; i < matchArenaCount; i++) canRestore = canRestore && ArenaRestore(matchArenas[i], &matchStart[i]);
+                ArenaClear(frameArena);
+
+                // The restored match is otherwise identical every time, so give it new food
+                PlaceInitialFood(ecs, board, initialFood, startBoard, positions, drawRects);
+                // The restored ECS's change ticks went back with it
+                drawSyncTick = 0;
+                runSystems = true;
+                tickTimer = 0.0f;
+            }
+            // Falls back to rebuilding everything if a snapshot could not be taken or restored
+            if (IsKeyPressed(KEY_R) && !canRestore)
             {
                 fprintf(stderr, "Freeing memory.\n");
+                for (int i = 0; i < matchArenaCount; i++) ArenaCheckpointFree(&matchStart[i]);
+                JobSystemRelease(&jobs);
+                ArenaDealloc(jobArena);
                 ArenaDealloc(generalArena);
+                ArenaDealloc(frameArena);
                 ArenaDealloc(ecsArena);
                 ArenaDealloc(componentArena);
+                ArenaDealloc(commandArena);
                 return RESTART_RETURN;
             }
         }
@@ -294,22 +421,45 @@ int GameLoop(const int screenW, const int screenH)
         sprintf(entitybuf, "Entities : %d", ecs->entities.currentEntities);
         DrawText(entitybuf, screenW * 0.05f, screenH * 0.05f + 40, DEBUG_FONT, DEBUG_TEXT_COLOR);
 
-        char ecsPageBuf[32];
-        sprintf(ecsPageBuf, "ECS Pages : %d", ecsArena->pages);
-        DrawText(ecsPageBuf, screenW * 0.05f, screenH * 0.05f + 60, DEBUG_FONT, DEBUG_TEXT_COLOR);
+        Arena *arenas[] = { ecsArena, componentArena, generalArena, frameArena, commandArena, jobArena };
+        const char *arenaNames[] = { "ECS", "Comp.", "Gen.", "Frame", "Cmd.", "Jobs" };
+        const uint32_t arenaCount = sizeof(arenas) / sizeof(arenas[0]);
+        for (int i = 0; i < arenaCount; i++)
+        {
+            DrawArenaStats(arenaNames[i], arenas[i], screenW * 0.05f, screenH * 0.05f + 60 + 20 * i, showArenaTags);
+        }
+
+        if (AllocCountEnabled())
+        {
+            char allocBuf[32];
+            sprintf(allocBuf, "Tick Allocs : %llu", (unsigned long long)tickAllocs);
+            DrawText(allocBuf, screenW * 0.05f, screenH * 0.05f + 60 + 20 * arenaCount, DEBUG_FONT, DEBUG_TEXT_COLOR);
+        }
 
-        char componentPageBuf[32];
-        sprintf(componentPageBuf, "Comp. Pages : %d", componentArena->pages);
-        DrawText(componentPageBuf, screenW * 0.05f, screenH * 0.05f + 80, DEBUG_FONT, DEBUG_TEXT_COLOR);
+        // Time spent in systems last tick, and the part of it no number of workers could overlap
+        char schedulerBuf[64];
+        sprintf(schedulerBuf, "Systems : %lluus, crit. path %lluus", (unsigned long long)(scheduler.workNs / 1000),
+                (unsigned long long)(scheduler.criticalPathNs / 1000));
+        DrawText(schedulerBuf, screenW * 0.05f, screenH * 0.05f + 80 + 20 * arenaCount, DEBUG_FONT, DEBUG_TEXT_COLOR);
 
-        char generalPageBuf[32];
-        sprintf(generalPageBuf, "Gen. Pages : %d", generalArena->pages);
-        DrawText(generalPageBuf, screenW * 0.05f, screenH * 0.05f + 100, DEBUG_FONT, DEBUG_TEXT_COLOR);
+        // F1 toggles the per-tag breakdown, F2 writes every arena's stats out as CSV
+        if (IsKeyPressed(KEY_F1)) showArenaTags = !showArenaTags;
+        if (IsKeyPressed(KEY_F2))
+        {
+            FILE *statsFile = fopen(ARENA_STATS_FILE, "w");
+            if (statsFile != NULL)
+            {
+                ArenaWriteStatsCSVHeader(statsFile);
+                for (int i = 0; i < arenaCount; i++) ArenaWriteStatsCSV(arenas[i], arenaNames[i], statsFile);
+                fclose(statsFile);
+                WriteConsole(console, "Arena stats written to " ARENA_STATS_FILE);
+            }
+        }
         //
         
-        DrawSystem(ecs, drawRects, texts, positions);
+        DrawSystem(ecs, &jobs, drawRects, texts, positions, &drawSyncTick);
 
-        ConsoleUpdate(&console);
+        ConsoleUpdate(console);
 
         EndDrawing();
     }
@@ -317,99 +467,230 @@ int GameLoop(const int screenW, const int screenH)
     CloseWindow();
 
     fprintf(stderr, "Freeing memory.\n");
+    for (int i = 0; i < matchArenaCount; i++) ArenaCheckpointFree(&matchStart[i]);
+    JobSystemRelease(&jobs);
+    ArenaDealloc(jobArena);
     ArenaDealloc(generalArena);
+    ArenaDealloc(frameArena);
     ArenaDealloc(ecsArena);
     ArenaDealloc(componentArena);
+    ArenaDealloc(commandArena);
+    // The main thread's scratch arenas, kept across restarts
+    ArenaScratchRelease();
 
     return SUCCESS_RETURN;
 }
 
-// Only call after BeginDrawing() has been called, and before drawing is done
-void DrawSystem(ECS *ecs, DrawRectSet drawRects, TextSet texts, PositionSet pos)
+// Adds the tick's systems to the scheduler, in the order they ran in before it, with what each one touches.
+// Every system here moves the snake or reads where it is, so in practice they still run one after another
+void AddGameSystems(Scheduler *scheduler, GameSystems *game)
 {
-    for (int i = 0; i < ecs->components[drawRects.id].size; i++)
-    {
-        uint32_t entityID = GetEntityID(ecs, i, drawRects.id);
-        if (!BITTEST(GetEntitySignature(ecs, entityID).bits, drawRects.id)) continue;
-        if (!BITTEST(GetEntitySignature(ecs, entityID).bits, pos.id)) continue;
-        
+    SystemAccess movement = { 0 };
+    SystemWrites(movement, game->controls);
+    SystemWrites(movement, game->positions);
+    SystemWrites(movement, game->colliders);
+    SystemPublishes(movement, PlayerDied);
+    SystemWritesResource(movement, RESOURCE_TILEMAP);
+    SchedulerAddSystem(scheduler, "PlayerMovement", RunPlayerMovement, game, movement);
+
+    SystemAccess collectible = { 0 };
+    SystemReads(collectible, game->collectibles);
+    SystemReads(collectible, game->positions);
+    SystemReads(collectible, game->colliders);
+    SystemPublishes(collectible, FoodEaten);
+    SystemWritesResource(collectible, RESOURCE_TILEMAP);
+    SystemWritesResource(collectible, RESOURCE_COMMANDS);
+    SchedulerAddSystem(scheduler, "Collectible", RunCollectible, game, collectible);
+
+    SystemAccess follow = { 0 };
+    SystemReads(follow, game->controls);
+    SystemReads(follow, game->followers);
+    SystemWrites(follow, game->positions);
+    SystemWritesResource(follow, RESOURCE_TILEMAP);
+    SchedulerAddSystem(scheduler, "Follow", RunFollow, game, follow);
+
+    SystemAccess snakeCollide = { 0 };
+    SystemReads(snakeCollide, game->colliders);
+    SystemReads(snakeCollide, game->positions);
+    SystemPublishes(snakeCollide, PlayerDied);
+    SystemReadsResource(snakeCollide, RESOURCE_SEGMENTS);
+    SchedulerAddSystem(scheduler, "SnakeCollide", RunSnakeCollide, game, snakeCollide);
+
+    // Creating entities through the command buffer hands out IDs right away
+    SystemAccess foodEaten = { 0 };
+    SystemSubscribes(foodEaten, FoodEaten);
+    SystemReadsResource(foodEaten, RESOURCE_TILEMAP);
+    SystemWritesResource(foodEaten, RESOURCE_SEGMENTS);
+    SystemWritesResource(foodEaten, RESOURCE_COMMANDS);
+    SystemWritesResource(foodEaten, RESOURCE_FRAME_ARENA);
+    foodEaten.structural = true;
+    SchedulerAddSystem(scheduler, "FoodEaten", RunFoodEaten, game, foodEaten);
+
+    SystemAccess playerDeath = { 0 };
+    SystemSubscribes(playerDeath, PlayerDied);
+    SystemWritesResource(playerDeath, RESOURCE_CONSOLE);
+    playerDeath.structural = true;
+    SchedulerAddSystem(scheduler, "PlayerDeath", RunPlayerDeath, game, playerDeath);
+}
 
-        uint32_t positionIndex = GetEntityIndex(ecs, entityID, pos.id);
+void RunPlayerMovement(void *context)
+{
+    GameSystems *game = context;
+    PlayerMovementSystem(game->ecs, game->events, game->snakeID, game->board, game->controls, game->positions, game->colliders);
+}
 
-        drawRects.set[i].rect.x = pos.set[positionIndex].world.x;
-        drawRects.set[i].rect.y = pos.set[positionIndex].world.y;
+void RunCollectible(void *context)
+{
+    GameSystems *game = context;
+    CollectibleSystem(game->ecs, game->events, game->commands, game->board, game->snakeID, game->collectibles, game->positions, game->colliders, game->drawRects);
+}
 
-        DrawRect cur = drawRects.set[i];
-        DrawRectangleRec(cur.rect, cur.color);
+void RunFollow(void *context)
+{
+    GameSystems *game = context;
+    FollowSystem(game->ecs, game->snakeID, game->board, game->controls, game->positions, game->followers);
+}
+
+void RunSnakeCollide(void *context)
+{
+    GameSystems *game = context;
+    SnakeCollideSystem(game->ecs, game->events, game->snakeID, game->segments, game->colliders, game->positions);
+}
+
+void RunFoodEaten(void *context)
+{
+    GameSystems *game = context;
+    FoodEatenSystem(game->ecs, game->events, game->commands, game->frameArena, game->board, game->snakeID, game->segments,
+                    game->followers, game->collectibles, game->positions, game->drawRects);
+}
+
+void RunPlayerDeath(void *context)
+{
+    GameSystems *game = context;
+    game->running = PlayerDeathSystem(game->ecs, game->events, game->console, game->texts, game->positions, game->screenW, game->screenH);
+}
+
+// Draws one line of used/committed/peak memory for an arena on the debug overlay,
+// with showTags every tag of the arena is listed to the right of it
+void DrawArenaStats(const char *name, Arena *arena, float x, float y, bool showTags)
+{
+    ArenaStats stats = ArenaGetStats(arena);
+
+    char statsBuf[96];
+    sprintf(statsBuf, "%s : %lluK / %lluK (peak %lluK)", name,
+            (unsigned long long)(stats.used / 1024), (unsigned long long)(stats.committed / 1024), (unsigned long long)(stats.highWater / 1024));
+    DrawText(statsBuf, x, y, DEBUG_FONT, DEBUG_TEXT_COLOR);
+
+    if (!showTags) return;
+
+    float tagX = x + MeasureText(statsBuf, DEBUG_FONT) + DEBUG_FONT;
+    for (int i = 0; i < stats.tagCount; i++)
+    {
+        if (stats.tags[i].pushes == 0) continue;
+
+        char tagBuf[96];
+        sprintf(tagBuf, "%s %lluK", stats.tags[i].tag, (unsigned long long)(stats.tags[i].bytes / 1024));
+        DrawText(tagBuf, tagX, y, ARENA_TAG_FONT, DEBUG_TEXT_COLOR);
+        tagX += MeasureText(tagBuf, ARENA_TAG_FONT) + ARENA_TAG_FONT;
     }
+}
 
-    for (int i = 0; i < ecs->components[texts.id].size; i++)
+// Moves the first food to a random tile that the snake does not start on
+void PlaceInitialFood(ECS *ecs, Tilemap board, uint32_t foodID, Vector2Int snakeStart, PositionSet pos, DrawRectSet draw)
+{
+    Vector2Int foodBoardPos;
+    do
     {
-        uint32_t entityID = GetEntityID(ecs, i, texts.id);
-        if (!BITTEST(GetEntitySignature(ecs, entityID).bits, texts.id)) continue;
-        if (!BITTEST(GetEntitySignature(ecs, entityID).bits, pos.id)) continue;
+        foodBoardPos = (Vector2Int){ rand() % board.width, rand() % board.width };
+    } while(foodBoardPos.x == snakeStart.x && foodBoardPos.y == snakeStart.y);
+    Vector2 foodWorldPos = 
+            { foodBoardPos.x * board.cellSize + (float)board.cellSize / 4.0f, foodBoardPos.y * board.cellSize + (float)board.cellSize / 4.0f };
 
-        uint32_t positionIndex = GetEntityIndex(ecs, entityID, pos.id);
+    *GetComponentMut(ecs, pos, foodID) = (Position){ foodWorldPos, foodBoardPos };
 
-        Text curText = texts.set[i];
-        Position curPos = pos.set[positionIndex];
-        DrawText(curText.text, curPos.world.x, curPos.world.y, curText.fontSize, curText.color);
+    DrawRect *foodRect = GetComponentMut(ecs, draw, foodID);
+    foodRect->rect.x = foodWorldPos.x;
+    foodRect->rect.y = foodWorldPos.y;
+}
+
+// Moves every rectangle to its entity's position, only touches the current entity so it runs in chunks on the job system
+void SyncDrawRects(ECSQuery *query, void *data)
+{
+    (void)data;
+    while (ECSQueryNext(query))
+    {
+        DrawRect *cur = ECSQueryComponentMut(query, DrawRect, 0);
+        Position *curPos = ECSQueryComponent(query, Position, 1);
+
+        cur->rect.x = curPos->world.x;
+        cur->rect.y = curPos->world.y;
+    }
+}
+
+// Only call after BeginDrawing() has been called, and before drawing is done.
+// lastSync is the change tick of the previous call, 0 to sync every rectangle
+void DrawSystem(ECS *ecs, JobSystem *jobs, DrawRectSet drawRects, TextSet texts, PositionSet pos, uint32_t *lastSync)
+{
+    // Only rectangles whose position was written since the last sync are moved
+    uint32_t since = *lastSync;
+    *lastSync = ECSAdvanceTick(ecs);
+
+    // raylib draws from the main thread only, so just the transform sync is split up
+    ECSQuery rects = ECSQueryBegin(ecs, ECSComponentList(drawRects.id, pos.id), NULL, 0);
+    ECSQueryChangedSince(&rects, 1, since);
+    ECSParallelForEach(jobs, &rects, DRAW_SYNC_CHUNK, SyncDrawRects, NULL);
+
+    rects = ECSQueryBegin(ecs, ECSComponentList(drawRects.id, pos.id), NULL, 0);
+    while (ECSQueryNext(&rects))
+    {
+        DrawRect *cur = ECSQueryComponent(&rects, DrawRect, 0);
+        DrawRectangleRec(cur->rect, cur->color);
+    }
+
+    ECSQuery labels = ECSQueryBegin(ecs, ECSComponentList(texts.id, pos.id), NULL, 0);
+    while (ECSQueryNext(&labels))
+    {
+        Text *curText = ECSQueryComponent(&labels, Text, 0);
+        Position *curPos = ECSQueryComponent(&labels, Position, 1);
+        DrawText(curText->text, curPos->world.x, curPos->world.y, curText->fontSize, curText->color);
     }
 
     return;
 }
 
-void CollectibleSystem(ECS *ecs, EventPool *events, Tilemap tilemap, uint32_t playerID, CollectibleSet collect, PositionSet pos, ColliderSet collide, DrawRectSet draw)
+void CollectibleSystem(ECS *ecs, EventPool *events, ECSCommandBuffer *commands, Tilemap tilemap, uint32_t playerID, CollectibleSet collect, PositionSet pos, ColliderSet collide, DrawRectSet draw)
 {
-    char *playerSignature = GetEntitySignature(ecs, playerID).bits;
+    uint64_t *playerSignature = GetEntitySignature(ecs, playerID);
     if (!BITTEST(playerSignature, collide.id)) return;
 
     uint32_t playerColliderIndex = GetEntityIndex(ecs, playerID, collide.id);
 
     Rectangle playerRect = collide.set[playerColliderIndex].rect;
 
-    uint32_t *toRemove = malloc(sizeof(*toRemove) * ecs->components[collect.id].size);
-    uint32_t removeCount = 0;
-    for (int i = 0; i < ecs->components[collect.id].size; i++)
+    ECSQuery query = ECSQueryBegin(ecs, ECSComponentList(collect.id, pos.id), NULL, 0);
+    while (ECSQueryNext(&query))
     {
-        uint32_t entityID = GetEntityID(ecs, i, collect.id);
-        char *entitySignature = GetEntitySignature(ecs, entityID).bits;
-        if (!BITTEST(entitySignature, collect.id)) continue;
-        if (!BITTEST(entitySignature, pos.id)) continue;
-
-        uint32_t positionIndex = GetEntityIndex(ecs, entityID, pos.id);
+        Collectible *collectible = ECSQueryComponent(&query, Collectible, 0);
+        Position *collectPos = ECSQueryComponent(&query, Position, 1);
 
         // Find if player is contacting a collectible
-        Vector2 collectPos = pos.set[positionIndex].world;
-
-        bool xAlign = (playerRect.x <= collectPos.x && playerRect.x + playerRect.width > collectPos.x);
-        bool yAlign = (playerRect.y <= collectPos.y && playerRect.y + playerRect.height >= collectPos.y);
+        bool xAlign = (playerRect.x <= collectPos->world.x && playerRect.x + playerRect.width > collectPos->world.x);
+        bool yAlign = (playerRect.y <= collectPos->world.y && playerRect.y + playerRect.height >= collectPos->world.y);
 
         // Run function ptr inside of touched collectible
         if (xAlign && yAlign)
         {
-            EventPoolPublish(events, collect.set[entityID].event, "", 0);
-            tilemap.map[pos.set[positionIndex].tile.x + (pos.set[positionIndex].tile.y * tilemap.width)] = false;
-            toRemove[removeCount] = entityID;
-            removeCount++;
+            EventPoolPublish(events, collectible->event, "", 0);
+            tilemap.map[collectPos->tile.x + (collectPos->tile.y * tilemap.width)] = false;
+            ECSCommandRemoveEntity(commands, query.entity);
         }
     }
-
-    for (int i = 0; i < removeCount; i++)
-    {
-        RemoveComponent(collect, ecs, toRemove[i]);
-        RemoveComponent(pos, ecs, toRemove[i]);
-        RemoveComponent(draw, ecs, toRemove[i]);
-        RemoveEntity(toRemove[i], ecs);
-    }
-
-    free(toRemove);
 }
 
 void PlayerMovementSystem(ECS *ecs, EventPool *events, uint32_t playerID, Tilemap tilemap, ControllerSet control, PositionSet pos, ColliderSet collide)
 {
     // Signature validation
-    char *playerSignature = GetEntitySignature(ecs, playerID).bits;
+    uint64_t *playerSignature = GetEntitySignature(ecs, playerID);
     if (!BITTEST(playerSignature, control.id)) return;
     if (!BITTEST(playerSignature, pos.id)) return;
     if (!BITTEST(playerSignature, collide.id)) return;
@@ -492,6 +773,7 @@ void PlayerMovementSystem(ECS *ecs, EventPool *events, uint32_t playerID, Tilema
     }
 
     // If no collision, move the player
+    ECSMarkChanged(ecs, playerID, pos.id);
     playerPos->prevWorld = playerPos->world;
     playerPos->prevTile = playerPos->tile;
 
@@ -518,45 +800,42 @@ void PlayerMovementSystem(ECS *ecs, EventPool *events, uint32_t playerID, Tilema
 
 void FollowSystem(ECS *ecs, uint32_t playerID, Tilemap tilemap, ControllerSet control, PositionSet pos, FollowerSet follow)
 {
-    char *playerSignature = GetEntitySignature(ecs, playerID).bits;
+    uint64_t *playerSignature = GetEntitySignature(ecs, playerID);
     if (!BITTEST(playerSignature, pos.id)) return;
     if (!BITTEST(playerSignature, control.id)) return;
 
     uint32_t playerControlIndex = GetEntityIndex(ecs, playerID, control.id);
     if (control.set[playerControlIndex].direction == -1) return;
 
-    for (int i = 0; i < ecs->components[follow.id].size; i++)
+    ECSQuery query = ECSQueryBegin(ecs, ECSComponentList(follow.id, pos.id), NULL, 0);
+    while (ECSQueryNext(&query))
     {
-        uint32_t entityID = GetEntityID(ecs, i, follow.id);
-
-        char *entitySignature = GetEntitySignature(ecs, entityID).bits;
-        if (!BITTEST(entitySignature, follow.id)) continue;
-        if (!BITTEST(entitySignature, pos.id)) continue;
+        Follower *follower = ECSQueryComponent(&query, Follower, 0);
+        Position *position = ECSQueryComponent(&query, Position, 1);
 
-        uint32_t positionIndex = GetEntityIndex(ecs, entityID, pos.id);
+        if (!ECSIsAlive(ecs, follower->follow)) continue;
+        Position *followedPos = &pos.set[GetEntityIndex(ecs, EntityHandleIndex(follower->follow), pos.id)];
 
-        uint32_t followedID = follow.set[i].followID;
-        uint32_t followedPositionIndex = GetEntityIndex(ecs, followedID, pos.id);
+        if (Vector2Compare(position->world, followedPos->prevWorld)) continue;
+        position = ECSQueryComponentMut(&query, Position, 1);
 
-        if (Vector2Compare(pos.set[positionIndex].world, pos.set[followedPositionIndex].prevWorld)) continue;
-
-        Vector2Int oldTile = pos.set[positionIndex].tile;
+        Vector2Int oldTile = position->tile;
         tilemap.map[oldTile.x + (oldTile.y * tilemap.width)] = false;
 
-        pos.set[positionIndex].prevWorld = pos.set[positionIndex].world;
-        pos.set[positionIndex].prevTile = pos.set[positionIndex].tile;
+        position->prevWorld = position->world;
+        position->prevTile = position->tile;
 
-        pos.set[positionIndex].world = pos.set[followedPositionIndex].prevWorld;
-        pos.set[positionIndex].tile = pos.set[followedPositionIndex].prevTile;
+        position->world = followedPos->prevWorld;
+        position->tile = followedPos->prevTile;
 
-        Vector2Int newTile = pos.set[positionIndex].tile;
+        Vector2Int newTile = position->tile;
         tilemap.map[newTile.x + (newTile.y * tilemap.width)] = true;
     }
 }
 
 void SnakeCollideSystem(ECS *ecs, EventPool *events, uint32_t playerID, Segments *segments, ColliderSet collide, PositionSet pos)
 {
-    char *playerSignature = GetEntitySignature(ecs, playerID).bits;
+    uint64_t *playerSignature = GetEntitySignature(ecs, playerID);
     if (!BITTEST(playerSignature, collide.id)) return;
 
     uint32_t playerColliderIndex = GetEntityIndex(ecs, playerID, collide.id);
@@ -565,10 +844,9 @@ void SnakeCollideSystem(ECS *ecs, EventPool *events, uint32_t playerID, Segments
 
     for (int i = 0; i < segments->count; i++)
     {
-        uint32_t segmentID = segments->entityIDs[i];
-
-        char *segmentSignature = GetEntitySignature(ecs, segmentID).bits;
-        if (!BITTEST(segmentSignature, pos.id)) continue;
+        // Segments always have a position, so a live handle is all that needs checking
+        if (!ECSIsAlive(ecs, segments->handles[i])) continue;
+        uint32_t segmentID = EntityHandleIndex(segments->handles[i]);
 
         uint32_t positionIndex = GetEntityIndex(ecs, segmentID, pos.id);
 
@@ -585,40 +863,41 @@ void SnakeCollideSystem(ECS *ecs, EventPool *events, uint32_t playerID, Segments
     }
 }
 
-void FoodEatenSystem(ECS *ecs, EventPool *events, Tilemap tilemap, uint32_t playerID, Segments *segments, FollowerSet follow, CollectibleSet collect, PositionSet pos, DrawRectSet draw)
+void FoodEatenSystem(ECS *ecs, EventPool *events, ECSCommandBuffer *commands, Arena *scratch, Tilemap tilemap, uint32_t playerID, Segments *segments, FollowerSet follow, CollectibleSet collect, PositionSet pos, DrawRectSet draw)
 {
     uint32_t *foodEatenIndex = EventPoolSubscribe(events, FoodEaten);
     if (foodEatenIndex == NULL) return;
 
     // Spawn new snake segment
-    uint32_t newSegmentID = CreateEntity(ecs);
+    uint32_t newSegmentID = ECSCommandCreateEntity(commands);
 
     Vector2 segmentWorld = { (float)-INT32_MAX, (float)-INT32_MAX };
     Vector2Int segmentTile = { 0, 0 };
-    AddComponent(newSegmentID, pos, ecs, ((Position){ segmentWorld, segmentTile, segmentWorld, segmentTile }));
+    DeferAddComponent(newSegmentID, pos, commands, ((Position){ segmentWorld, segmentTile, segmentWorld, segmentTile }));
 
     DrawRect segmentRect;
     float segmentDimension = tilemap.cellSize * SEGMENT_SCALE;
     segmentRect.rect = (Rectangle){ segmentWorld.x, segmentWorld.y, segmentDimension, segmentDimension };
     segmentRect.color = SNAKE_COLOR;
-    AddComponent(newSegmentID, draw, ecs, segmentRect);
+    DeferAddComponent(newSegmentID, draw, commands, segmentRect);
 
-    uint32_t idToFollow;
+    EntityHandle toFollow;
     if (segments->count == 0)
-        idToFollow = playerID;
+        toFollow = GetEntityHandle(ecs, playerID);
     else
-        idToFollow = segments->entityIDs[segments->count - 1];
+        toFollow = segments->handles[segments->count - 1];
 
-    AddComponent(newSegmentID, follow, ecs, ((Follower){ idToFollow }));
+    DeferAddComponent(newSegmentID, follow, commands, ((Follower){ toFollow }));
 
-    segments->entityIDs[segments->count] = newSegmentID;
+    segments->handles[segments->count] = GetEntityHandle(ecs, newSegmentID);
     segments->count++;
 
     // Spawn new food collectible
-    uint32_t newFoodID = CreateEntity(ecs);
+    uint32_t newFoodID = ECSCommandCreateEntity(commands);
 
     uint32_t mapArea = tilemap.width * tilemap.height;
-    uint32_t *validTiles = malloc(sizeof(*validTiles) * mapArea);
+    ArenaTemp temp = ArenaTempBegin(scratch);
+    uint32_t *validTiles = PushArray(scratch, uint32_t, mapArea);
     uint32_t validTileCount = 0;
     for (int i = 0; i < mapArea; i++)
     {
@@ -633,16 +912,16 @@ void FoodEatenSystem(ECS *ecs, EventPool *events, Tilemap tilemap, uint32_t play
     uint32_t foodDimension = tilemap.cellSize / 2;
     Vector2 worldCoords = 
         { tileCoords.x * tilemap.cellSize + ((float)foodDimension / 2.0f), tileCoords.y * tilemap.cellSize + ((float)foodDimension / 2.0f) };
-    AddComponent(newFoodID, pos, ecs, ((Position){ worldCoords, tileCoords }));
+    DeferAddComponent(newFoodID, pos, commands, ((Position){ worldCoords, tileCoords }));
 
     DrawRect foodRect;
     foodRect.rect = (Rectangle){ worldCoords.x, worldCoords.y, foodDimension, foodDimension };
     foodRect.color = FOOD_COLOR;
-    AddComponent(newFoodID, draw, ecs, foodRect);
+    DeferAddComponent(newFoodID, draw, commands, foodRect);
 
-    AddComponent(newFoodID, collect, ecs, (Collectible){ FoodEaten });
+    DeferAddComponent(newFoodID, collect, commands, ((Collectible){ FoodEaten }));
 
-    free(validTiles);
+    ArenaTempEnd(temp);
     //
 }
 
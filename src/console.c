@@ -31,11 +31,15 @@ bool InitConsole(Console *log, Arena *arena, Rectangle rect, uint32_t maxMessage
     log->displayStart = 0;
     log->displayEnd = 0;
 
+    const char *previousTag = ArenaSetTag(arena, "console");
     log->messages = PushArray(arena, ConsoleMessage, maxMessages);
     for (int i = 0; i < maxMessages; i++)
     {
-        log->messages[i].message = PushArray(arena, char, charLimit);
+        log->messages[i].message = NULL;
     }
+    ArenaSetTag(arena, previousTag);
+
+    if (!PoolInit(&log->strings, arena)) return false;
 
     log->scrollUp = -1;
     log->scrollDown = -1;
@@ -64,9 +68,19 @@ void ConsoleSetOutline(Console *log, float x, float y, float width, float height
 
 void WriteConsole(Console *log, char *message)
 {
-    // Copy the message passed to the nearest empty message memory,
+    // Copy the message passed into memory sized for it, up to charLimit,
     // this is done to avoid the user passing a string with limited scope
-    strcpy(log->messages[log->numMessages].message, message);
+    uint64_t size = strlen(message) + 1;
+    if (size > log->charLimit) size = log->charLimit;
+
+    // Char limits above the pool's largest size class go straight onto the arena
+    char *copy = PoolAlloc(&log->strings, size);
+    if (copy == NULL) copy = ArenaPush(log->strings.arena, size, 1);
+    if (copy == NULL) return;
+
+    memcpy(copy, message, size - 1);
+    copy[size - 1] = '\0';
+    log->messages[log->numMessages].message = copy;
 
     // If this message would over-fill the window, scroll the rest of the text up by one font height,
     // this currently needs fixing as it will not recognize if you scroll the text up manually
@@ -0,0 +1,54 @@
+#include <string.h>
+#include <stddef.h>
+#include <stdalign.h>
+#include "../include/dynamicarray.h"
+
+// Values are pushed with the strictest alignment any type needs,
+// since the macros only know the size of the values
+#define DYNAMIC_ARRAY_ALIGN alignof(max_align_t)
+
+bool DynamicArrayGrow(Arena *arena, void *valuesPtr, uint32_t len, uint32_t *capacity, uint32_t needed, uint64_t valueSize)
+{
+    unsigned char *values;
+    memcpy(&values, valuesPtr, sizeof(values));
+
+    // Double the capacity so pushing one value at a time is amortized O(1)
+    uint64_t newCapacity = (uint64_t)*capacity * 2;
+    if (newCapacity < DYNAMIC_ARRAY_MIN_CAPACITY) newCapacity = DYNAMIC_ARRAY_MIN_CAPACITY;
+    if (newCapacity < needed) newCapacity = needed;
+    if (newCapacity > UINT32_MAX) newCapacity = UINT32_MAX;
+    if (newCapacity < needed) return false;
+
+    // On top of the arena the array can grow in place, as long as the arena
+    // does not have to continue in a new chained block to fit it
+    unsigned char *end = values + valueSize * *capacity;
+    if (values != NULL && ArenaTop(arena) == end)
+    {
+        uint64_t growBytes = valueSize * (newCapacity - *capacity);
+        unsigned char *grown = ArenaPush(arena, growBytes, 1);
+        if (grown == end)
+        {
+            *capacity = (uint32_t)newCapacity;
+            return true;
+        }
+        if (grown != NULL) ArenaPop(arena, growBytes);
+    }
+
+    unsigned char *moved = ArenaPush(arena, valueSize * newCapacity, DYNAMIC_ARRAY_ALIGN);
+    if (moved == NULL) return false;
+    if (len > 0) memcpy(moved, values, valueSize * len);
+
+    memcpy(valuesPtr, &moved, sizeof(moved));
+    *capacity = (uint32_t)newCapacity;
+
+    return true;
+}
+
+void DynamicArrayShrink(Arena *arena, void *values, uint32_t len, uint32_t *capacity, uint64_t valueSize)
+{
+    unsigned char *end = (unsigned char *)values + valueSize * *capacity;
+    if (values == NULL || ArenaTop(arena) != end) return;
+
+    ArenaPop(arena, valueSize * (*capacity - len));
+    *capacity = len;
+}
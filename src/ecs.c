@@ -3,6 +3,13 @@
 #include <stdalign.h>
 #include <stdlib.h>
 #include "../include/ecs.h"
+#include "../include/dynamicarray.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 ///////////////////////////////////////
 /// Array Queue (For entitiy IDs) /////
@@ -12,8 +19,9 @@ bool InitIDQueue(IDQueue *q, Arena *mem, uint32_t capacity)
 {
     // TODO: error handling
 
-    q->arr = PushArray(mem, uint32_t, capacity);
-    if (q->arr == NULL) return false;
+    uint32_t *arr = PushArray(mem, uint32_t, capacity);
+    if (arr == NULL) return false;
+    ArenaRelSet(q->arr, arr);
 
     q->capacity = capacity;
     q->size = 0;
@@ -28,7 +36,7 @@ bool IDEnqueue(IDQueue *q, uint32_t value)
 {
     if (q->size >= q->capacity) return false;
 
-    q->arr[q->tail] = value;
+    ArenaRelPtr(uint32_t, q->arr)[q->tail] = value;
     q->size++;
     q->tail = (q->tail + 1) % q->capacity;
 
@@ -47,7 +55,7 @@ bool IDDequeue(IDQueue *q)
 
 uint32_t IDQueuePeek(IDQueue *q)
 {
-    return q->size != 0 ? q->arr[q->head] : -1;
+    return q->size != 0 ? ArenaRelPtr(uint32_t, q->arr)[q->head] : -1;
 }
 
 ///////////////////////////////////////
@@ -55,15 +63,113 @@ uint32_t IDQueuePeek(IDQueue *q)
 ///////////////////////////////////////
 
 ///////////////////////////////////////
-/// Bitset (For entity signatures) ////
+/// Signatures ////////////////////////
 ///////////////////////////////////////
 
-bool InitBitset(Bitset *b, Arena *mem, uint32_t size)
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+// Positions of the set lanes of a 4 lane match mask packed to the front, and how many there are,
+// so the matches of 4 entities are appended with one store instead of a branch per lane
+static const uint32_t laneOffsets[16][4] = {
+    { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 1, 0, 0, 0 }, { 0, 1, 0, 0 },
+    { 2, 0, 0, 0 }, { 0, 2, 0, 0 }, { 1, 2, 0, 0 }, { 0, 1, 2, 0 },
+    { 3, 0, 0, 0 }, { 0, 3, 0, 0 }, { 1, 3, 0, 0 }, { 0, 1, 3, 0 },
+    { 2, 3, 0, 0 }, { 0, 2, 3, 0 }, { 1, 2, 3, 0 }, { 0, 1, 2, 3 }
+};
+static const uint8_t laneCounts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+// Writes past the last match stay below base + 4, so they never leave the matches array
+#define AppendMatches(matches, matchCount, base, laneMask) {\
+    __m128i offsets = _mm_loadu_si128((const __m128i *)laneOffsets[laneMask]);\
+    _mm_storeu_si128((__m128i *)&(matches)[matchCount], _mm_add_epi32(_mm_set1_epi32((int)(base)), offsets));\
+    matchCount += laneCounts[laneMask];\
+}
+#endif
+
+#if !defined(__AVX2__) && (defined(__SSE2__) || defined(_M_X64))
+// Mask with a bit set for each of the two signatures in sig that match
+static uint32_t MatchPair(__m128i sig, __m128i requiredWide, __m128i excludedWide)
 {
-    b->size = BITNSLOTS(size);
+    // Zero where every required bit is set and no excluded one is
+    __m128i missing = _mm_xor_si128(_mm_and_si128(sig, requiredWide), requiredWide);
+    __m128i miss = _mm_or_si128(missing, _mm_and_si128(sig, excludedWide));
+
+    // SSE2 has no 64 bit compare, a lane is zero if both of its 32 bit halves are
+    __m128i zero = _mm_cmpeq_epi32(miss, _mm_setzero_si128());
+    zero = _mm_and_si128(zero, _mm_shuffle_epi32(zero, _MM_SHUFFLE(2, 3, 0, 1)));
 
-    b->bits = PushArrayZero(mem, char, size);
-    return (b->bits != NULL);
+    return (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(zero));
+}
+#endif
+
+uint32_t ECSMatchSignatures(const uint64_t *signatures, uint32_t signatureWords, const uint64_t *required, const uint64_t *excluded,
+                            const uint32_t *entities, uint32_t count, uint32_t *matches)
+{
+    uint32_t matchCount = 0;
+    uint32_t i = 0;
+
+#if defined(__AVX2__)
+    if (signatureWords == 1)
+    {
+        __m256i requiredWide = _mm256_set1_epi64x((long long)required[0]);
+        __m256i excludedWide = _mm256_set1_epi64x((long long)excluded[0]);
+        for (; i + 4 <= count; i += 4)
+        {
+            // Four scalar loads beat vpgatherqq on most CPUs that have it
+            __m256i sig = (entities != NULL)
+                ? _mm256_set_epi64x((long long)signatures[entities[i + 3]], (long long)signatures[entities[i + 2]],
+                                    (long long)signatures[entities[i + 1]], (long long)signatures[entities[i]])
+                : _mm256_loadu_si256((const __m256i *)&signatures[i]);
+
+            // Zero where every required bit is set and no excluded one is
+            __m256i missing = _mm256_xor_si256(_mm256_and_si256(sig, requiredWide), requiredWide);
+            __m256i miss = _mm256_or_si256(missing, _mm256_and_si256(sig, excludedWide));
+            uint32_t laneMask = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(miss, _mm256_setzero_si256())));
+
+            AppendMatches(matches, matchCount, i, laneMask);
+        }
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    if (signatureWords == 1)
+    {
+        __m128i requiredWide = _mm_set1_epi64x((long long)required[0]);
+        __m128i excludedWide = _mm_set1_epi64x((long long)excluded[0]);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i low, high;
+            if (entities != NULL)
+            {
+                low = _mm_set_epi64x((long long)signatures[entities[i + 1]], (long long)signatures[entities[i]]);
+                high = _mm_set_epi64x((long long)signatures[entities[i + 3]], (long long)signatures[entities[i + 2]]);
+            }
+            else
+            {
+                low = _mm_loadu_si128((const __m128i *)&signatures[i]);
+                high = _mm_loadu_si128((const __m128i *)&signatures[i + 2]);
+            }
+
+            uint32_t laneMask = MatchPair(low, requiredWide, excludedWide) | (MatchPair(high, requiredWide, excludedWide) << 2);
+
+            AppendMatches(matches, matchCount, i, laneMask);
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        uint32_t entity = (entities != NULL) ? entities[i] : i;
+        const uint64_t *signature = &signatures[(uint64_t)entity * signatureWords];
+
+        bool match = true;
+        for (uint32_t w = 0; w < signatureWords; w++)
+        {
+            if ((signature[w] & required[w]) != required[w] || (signature[w] & excluded[w]) != 0) match = false;
+        }
+
+        matches[matchCount] = i;
+        matchCount += match;
+    }
+
+    return matchCount;
 }
 
 ///////////////////////////////////////
@@ -75,38 +181,44 @@ bool InitBitset(Bitset *b, Arena *mem, uint32_t size)
 /// Entity Set ////////////////////////
 ///////////////////////////////////////
 
-bool InitEntityData(EntityData *m, Arena *mem, uint32_t maxEntities)
+bool InitEntityData(EntityData *m, Arena *mem, uint32_t maxEntities, uint32_t maxComponents)
 {
     m->currentEntities = 0;
     m->maxEntities = maxEntities;
+    m->nextUnused = 0;
+    m->signatureWords = BITNSLOTS(maxComponents);
     
+    // Starts empty, only removed IDs are ever enqueued
     if (!InitIDQueue(&m->eIDs, mem, maxEntities)) return false;
-    for (int i = 0; i < maxEntities; i++)
-    {
-        // If queue was full and value not enqueued, return false
-        if (!IDEnqueue(&m->eIDs, i)) return false;
-    }
     
-    m->eSignatures = PushArray(mem, Bitset, maxEntities);
-    if (m->eSignatures == NULL) return false;
+    // One block for every signature, so matching walks contiguous words.
+    // Left uninitialized, CreateEntity clears each one the first time its ID is used
+    uint64_t *signatures = PushArray(mem, uint64_t, (uint64_t)maxEntities * m->signatureWords);
+    if (signatures == NULL) return false;
+    ArenaRelSet(m->eSignatures, signatures);
+
+    uint16_t *generations = PushArray(mem, uint16_t, maxEntities);
+    if (generations == NULL) return false;
+    ArenaRelSet(m->generations, generations);
 
     return true;
 }
 
-bool SetSignature(EntityData *m, uint32_t entity, Bitset signature)
+bool SetSignature(EntityData *m, uint32_t entity, const uint64_t *signature)
 {
-    if (entity >= m->maxEntities) return false;
+    uint64_t *dest = GetSignature(m, entity);
+    if (dest == NULL) return false;
 
-    m->eSignatures[entity] = signature;
+    memcpy(dest, signature, sizeof(uint64_t) * m->signatureWords);
 
     return true;
 }
 
-Bitset *GetSignature(EntityData *m, uint32_t entity)
+uint64_t *GetSignature(EntityData *m, uint32_t entity)
 {
-    if (entity >= m->maxEntities) return NULL;
+    if (entity >= m->nextUnused) return NULL;
 
-    return &m->eSignatures[entity];
+    return ArenaRelPtr(uint64_t, m->eSignatures) + (uint64_t)entity * m->signatureWords;
 }
 
 ///////////////////////////////////////
@@ -118,28 +230,80 @@ Bitset *GetSignature(EntityData *m, uint32_t entity)
 /// Entity Component Association //////
 ///////////////////////////////////////
 
-// -1 used to denote non-associated indices
-bool InitComponentDict(ComponentDict *c, Arena *mem, uint32_t maxEntities)
+// -1 used to denote non-associated indices, a page starts out all -1
+bool InitComponentDict(ComponentDict *c, Arena *mem, uint32_t maxEntities, uint32_t *emptyPage)
 {
     // TODO: error handling
     c->size = 0;
+    c->data = 0;
+    c->valueSize = 0;
+    c->valueAlign = 0;
+    c->capacity = 0;
+    c->indexToEntity = 0;
+    c->changed = 0;
 
-    c->entityToIndex = PushArray(mem, uint32_t, maxEntities);
-    memset(c->entityToIndex, -1, sizeof(uint32_t) * maxEntities);
-    c->indexToEntity = PushArray(mem, uint32_t, maxEntities);
-    memset(c->indexToEntity, -1, sizeof(uint32_t) * maxEntities);
+    uint32_t pageCount = (maxEntities + ECS_SPARSE_PAGE_SIZE - 1) / ECS_SPARSE_PAGE_SIZE;
+    ArenaRel *pages = PushArray(mem, ArenaRel, pageCount);
+    if (pages == NULL) return false;
+    for (uint32_t i = 0; i < pageCount; i++) ArenaRelSet(pages[i], emptyPage);
+    ArenaRelSet(c->entityToIndex, pages);
+    ArenaRelSet(c->emptyPage, emptyPage);
 
     return true;
 }
 
-bool AddComponentDict(uint32_t entity, ComponentDict *container)
+// Make room in the dense arrays for at least count entries, the change ticks grow to the same capacity
+static bool ReserveComponentDict(ComponentDict *container, Arena *mem, uint32_t count)
 {
+    if (count <= container->capacity) return true;
+
+    uint32_t *indexToEntity = ArenaRelPtr(uint32_t, container->indexToEntity);
+    uint32_t *changed = ArenaRelPtr(uint32_t, container->changed);
+    uint32_t entityCapacity = container->capacity;
+    uint32_t changedCapacity = container->capacity;
+    const char *previousTag = ArenaSetTag(mem, "ecs.components");
+    bool grown = DynamicArrayGrow(mem, &indexToEntity, container->size, &entityCapacity, count, sizeof(uint32_t)) &&
+                 DynamicArrayGrow(mem, &changed, container->size, &changedCapacity, entityCapacity, sizeof(uint32_t));
+    ArenaSetTag(mem, previousTag);
+    if (!grown) return false;
+    ArenaRelSet(container->indexToEntity, indexToEntity);
+    ArenaRelSet(container->changed, changed);
+    container->capacity = entityCapacity;
+
+    return true;
+}
+
+// Index slot of an entity that can be written to, allocating its page if it is still the empty page
+//
+// Return - Pointer to the slot, NULL on failure
+static uint32_t *WritableSlot(ComponentDict *container, Arena *mem, uint32_t entity)
+{
+    ArenaRel *pageRel = &ArenaRelPtr(ArenaRel, container->entityToIndex)[entity / ECS_SPARSE_PAGE_SIZE];
+    if (ECSSparsePage(*pageRel) == ArenaRelPtr(uint32_t, container->emptyPage))
+    {
+        uint32_t *page = PushArrayTagged(mem, uint32_t, ECS_SPARSE_PAGE_SIZE, "ecs.components");
+        if (page == NULL) return NULL;
+        memset(page, -1, sizeof(uint32_t) * ECS_SPARSE_PAGE_SIZE);
+        ArenaRelSet(*pageRel, page);
+    }
+
+    return &ECSSparsePage(*pageRel)[entity % ECS_SPARSE_PAGE_SIZE];
+}
+
+bool AddComponentDict(uint32_t entity, ComponentDict *container, Arena *mem)
+{
+    uint32_t *slot = WritableSlot(container, mem, entity);
+    if (slot == NULL) return false;
+
     // TODO: prevent double-adding, which is why this returns a bool.
-    if (container->entityToIndex[entity] != -1) return false;
+    if (*slot != -1) return false;
     uint32_t index = container->size;
 
-    container->entityToIndex[entity] = index;
-    container->indexToEntity[index] = entity;
+    if (!ReserveComponentDict(container, mem, index + 1)) return false;
+
+    *slot = index;
+    ArenaRelPtr(uint32_t, container->indexToEntity)[index] = entity;
+    ArenaRelPtr(uint32_t, container->changed)[index] = 0;
 
     container->size++;
 
@@ -148,15 +312,20 @@ bool AddComponentDict(uint32_t entity, ComponentDict *container)
 
 bool RemoveComponentDict(uint32_t entity, ComponentDict *container)
 {
-    if (container->entityToIndex[entity] == -1) return false;
+    uint32_t *slot = &ComponentDictIndex(container, entity);
+    if (*slot == -1) return false;
 
-    uint32_t removedIndex = container->entityToIndex[entity];
-    container->entityToIndex[entity] = -1;
+    uint32_t *indexToEntity = ArenaRelPtr(uint32_t, container->indexToEntity);
+
+    uint32_t removedIndex = *slot;
+    *slot = -1;
     uint32_t lastIndex = container->size - 1;
 
-    uint32_t lastEntity = container->indexToEntity[lastIndex];
-    container->entityToIndex[lastEntity] = removedIndex;
-    container->indexToEntity[removedIndex] = lastEntity;
+    uint32_t lastEntity = indexToEntity[lastIndex];
+    if (lastEntity != entity) ComponentDictIndex(container, lastEntity) = removedIndex;
+    indexToEntity[removedIndex] = lastEntity;
+    uint32_t *changed = ArenaRelPtr(uint32_t, container->changed);
+    changed[removedIndex] = changed[lastIndex];
 
     container->size--;
 
@@ -175,81 +344,778 @@ bool RemoveComponentDict(uint32_t entity, ComponentDict *container)
 bool ECSInit(ECS *ecs, Arena *mem, uint32_t maxEntities, uint32_t maxComponents)
 {
     // TODO: error handling
+    if (BITNSLOTS(maxComponents) > ECS_SIGNATURE_MAX_WORDS) return false;
+    if (maxEntities > ENTITY_INDEX_MASK) return false;
 
+    ecs->arena = mem;
     ecs->maxComponents = maxComponents;
     ecs->currentComponents = 0;
+    ecs->bitPlanes = 0;
+    ecs->planeWords = BITNSLOTS(maxEntities);
+    ecs->queryBackend = ECS_QUERY_SPARSE_SETS;
+    ecs->changeTick = 1;
+
+    const char *previousTag = ArenaSetTag(mem, "ecs.components");
 
     // Arena allocation for component types
-    ecs->components = PushArray(mem, ComponentDict, maxComponents);
+    ComponentDict *components = PushArray(mem, ComponentDict, maxComponents);
+    ArenaRelSet(ecs->components, components);
+
+    uint32_t *emptyPage = PushArray(mem, uint32_t, ECS_SPARSE_PAGE_SIZE);
+    memset(emptyPage, -1, sizeof(uint32_t) * ECS_SPARSE_PAGE_SIZE);
+    ArenaRelSet(ecs->emptyPage, emptyPage);
 
     // Arena allocation for arrays within each component
     for (int i = 0; i < maxComponents; i++)
     {
-        InitComponentDict(&ecs->components[i], mem, maxEntities);
+        InitComponentDict(&components[i], mem, maxEntities, emptyPage);
     }
 
     // Arena allocation for entitiy set arrays
-    InitEntityData(&ecs->entities, mem, maxEntities); // ARENA-FY THIS, currently memory leaks
-    for (int i = 0; i < maxEntities; i++)
-    {
-        // Arena allocation for bitset arrays within entities
-        InitBitset(&ecs->entities.eSignatures[i], mem, maxComponents);
-    }
+    ArenaSetTag(mem, "ecs.entities");
+    InitEntityData(&ecs->entities, mem, maxEntities, maxComponents);
+
+    ArenaSetTag(mem, previousTag);
 
     return true;
 }
 
+void ECSBindArena(ECS *ecs, Arena *mem)
+{
+    ecs->arena = mem;
+}
+
 uint32_t CreateEntity(ECS *ecs)
 {
     EntityData *data = &ecs->entities;
     if (data->currentEntities >= data->maxEntities) return -1;
 
-    uint32_t id = IDQueuePeek(&data->eIDs);
-    if (id == -1) return -1;
-    IDDequeue(&data->eIDs);
+    uint16_t *generations = ArenaRelPtr(uint16_t, data->generations);
+
+    uint32_t id;
+    if (data->nextUnused < data->maxEntities)
+    {
+        // First use of the ID, so its state is set up here instead of in ECSInit
+        id = data->nextUnused++;
+        memset(GetSignature(data, id), 0, sizeof(uint64_t) * data->signatureWords);
+        generations[id] = 0;
+    }
+    else
+    {
+        id = IDQueuePeek(&data->eIDs);
+        if (id == -1) return -1;
+        IDDequeue(&data->eIDs);
+    }
     data->currentEntities++;
 
+    generations[id] = (generations[id] + 1) & ENTITY_GENERATION_MASK;
+
     return id;
 }
 
 bool RemoveEntity(uint32_t entity, ECS *ecs)
 {
     EntityData *data = &ecs->entities;
-    if (entity >= data->maxEntities) return false;
+    if (entity >= data->nextUnused) return false;
 
-    memset(data->eSignatures[entity].bits, 0, data->eSignatures[entity].size);
+    uint16_t *generations = ArenaRelPtr(uint16_t, data->generations);
+    if ((generations[entity] & 1) == 0) return false;
+    generations[entity] = (generations[entity] + 1) & ENTITY_GENERATION_MASK;
 
-    if (!IDEnqueue(&data->eIDs, entity)) return false;
-    data->currentEntities--;
-   
-    for (int i = 0; i < ecs->maxComponents; i++)
+    // Only the set bits are visited, removing each component clears its bit (and plane bit)
+    // so the signature ends up all 0's
+    uint64_t *signature = GetSignature(data, entity);
+    for (uint32_t w = 0; w < data->signatureWords; w++)
     {
-        RemoveComponentDict(entity, &ecs->components[i]);
+        uint64_t word = signature[w];
+        while (word != 0)
+        {
+            uint32_t componentID = w * ECS_SIGNATURE_WORD_BITS + (uint32_t)__builtin_ctzll(word);
+            word &= word - 1;
+            ECSRemoveComponent(entity, ecs, componentID);
+        }
     }
 
+    if (!IDEnqueue(&data->eIDs, entity)) return false;
+    data->currentEntities--;
+
     return true;
 }
 
+EntityHandle GetEntityHandle(ECS *ecs, uint32_t entity)
+{
+    if (entity >= ecs->entities.nextUnused) return ENTITY_HANDLE_NONE;
+
+    uint32_t generation = ArenaRelPtr(uint16_t, ecs->entities.generations)[entity];
+    return (generation << ENTITY_INDEX_BITS) | entity;
+}
+
+bool ECSIsAlive(ECS *ecs, EntityHandle handle)
+{
+    uint32_t entity = EntityHandleIndex(handle);
+    if (entity >= ecs->entities.nextUnused) return false;
+
+    uint32_t generation = ArenaRelPtr(uint16_t, ecs->entities.generations)[entity];
+    return (generation & 1) != 0 && generation == EntityHandleGeneration(handle);
+}
+
 bool AssociateComponent(uint32_t entity, ECS *ecs, uint32_t componentID)
 {
+    if (entity >= ecs->entities.nextUnused) return false;
     // Update component set to reflect new component
-    if (!AddComponentDict(entity, &ecs->components[componentID])) return false;
+    ComponentDict *component = &ECSComponents(ecs)[componentID];
+    if (!AddComponentDict(entity, component, ecs->arena)) return false;
+    ArenaRelPtr(uint32_t, component->changed)[component->size - 1] = ecs->changeTick;
     // Update entity signature to reflect new component
-    BITSET(ecs->entities.eSignatures[entity].bits, componentID);
+    BITSET(GetEntitySignature(ecs, entity), componentID);
+    if (ecs->bitPlanes != 0) BITSET(ECSBitPlane(ecs, componentID), entity);
 
     return true;
 }
 
 bool UnassociateComponent(uint32_t entity, ECS *ecs, uint32_t componentID)
 {
+    if (entity >= ecs->entities.nextUnused) return false;
     // Update component set to reflect removed component
-    if (!RemoveComponentDict(entity, &ecs->components[componentID])) return false;
+    if (!RemoveComponentDict(entity, &ECSComponents(ecs)[componentID])) return false;
     // Update entity signature to reflect removed component
-    BITCLEAR(ecs->entities.eSignatures[entity].bits, componentID);
+    BITCLEAR(GetEntitySignature(ecs, entity), componentID);
+    if (ecs->bitPlanes != 0) BITCLEAR(ECSBitPlane(ecs, componentID), entity);
 
     return true;
 }
 
+bool ECSRemoveComponent(uint32_t entity, ECS *ecs, uint32_t componentID)
+{
+    if (entity >= ecs->entities.nextUnused || componentID >= ecs->maxComponents) return false;
+
+    ComponentDict *component = &ECSComponents(ecs)[componentID];
+    uint32_t removedIndex = ComponentDictIndex(component, entity);
+    if (removedIndex == UINT32_MAX) return false;
+
+    // Components associated without RegisterComponent have no data to move
+    unsigned char *values = ArenaRelPtr(unsigned char, component->data);
+    uint32_t lastIndex = component->size - 1;
+    if (values != NULL && removedIndex != lastIndex)
+    {
+        memcpy(values + (uint64_t)removedIndex * component->valueSize,
+               values + (uint64_t)lastIndex * component->valueSize, component->valueSize);
+    }
+
+    return UnassociateComponent(entity, ecs, componentID);
+}
+
+uint32_t ECSAdvanceTick(ECS *ecs)
+{
+    return ++ecs->changeTick;
+}
+
+uint32_t ECSMarkChanged(ECS *ecs, uint32_t entity, uint32_t componentID)
+{
+    ComponentDict *component = &ECSComponents(ecs)[componentID];
+    uint32_t index = ComponentDictIndex(component, entity);
+    if (index != UINT32_MAX) ArenaRelPtr(uint32_t, component->changed)[index] = ecs->changeTick;
+
+    return index;
+}
+
+bool ECSSetQueryBackend(ECS *ecs, Arena *mem, ECSQueryBackend backend)
+{
+    if (backend == ECS_QUERY_BIT_PLANES && ecs->bitPlanes == 0)
+    {
+        const char *previousTag = ArenaSetTag(mem, "ecs.bitplanes");
+        uint64_t *planes = PushArrayZero(mem, uint64_t, (uint64_t)ecs->maxComponents * ecs->planeWords);
+        ArenaSetTag(mem, previousTag);
+        if (planes == NULL) return false;
+        ArenaRelSet(ecs->bitPlanes, planes);
+
+        // Removed entities have zeroed signatures, so every set bit belongs to a live entity
+        for (uint32_t entity = 0; entity < ecs->entities.nextUnused; entity++)
+        {
+            uint64_t *signature = GetEntitySignature(ecs, entity);
+            for (uint32_t i = 0; i < ecs->maxComponents; i++)
+            {
+                if (BITTEST(signature, i)) BITSET(ECSBitPlane(ecs, i), entity);
+            }
+        }
+    }
+
+    ecs->queryBackend = backend;
+
+    return true;
+}
+
+void ECSCombineBitPlanes(const uint64_t *const *required, uint32_t requiredCount,
+                         const uint64_t *const *excluded, uint32_t excludedCount, uint32_t wordCount, uint64_t *out)
+{
+    uint32_t w = 0;
+
+#if defined(__AVX2__)
+    for (; w + 4 <= wordCount; w += 4)
+    {
+        __m256i word = _mm256_set1_epi64x(-1);
+        for (uint32_t i = 0; i < requiredCount; i++) word = _mm256_and_si256(word, _mm256_loadu_si256((const __m256i *)&required[i][w]));
+        for (uint32_t i = 0; i < excludedCount; i++) word = _mm256_andnot_si256(_mm256_loadu_si256((const __m256i *)&excluded[i][w]), word);
+        _mm256_storeu_si256((__m256i *)&out[w], word);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    for (; w + 2 <= wordCount; w += 2)
+    {
+        __m128i word = _mm_set1_epi64x(-1);
+        for (uint32_t i = 0; i < requiredCount; i++) word = _mm_and_si128(word, _mm_loadu_si128((const __m128i *)&required[i][w]));
+        for (uint32_t i = 0; i < excludedCount; i++) word = _mm_andnot_si128(_mm_loadu_si128((const __m128i *)&excluded[i][w]), word);
+        _mm_storeu_si128((__m128i *)&out[w], word);
+    }
+#endif
+
+    for (; w < wordCount; w++)
+    {
+        uint64_t word = ~0ULL;
+        for (uint32_t i = 0; i < requiredCount; i++) word &= required[i][w];
+        for (uint32_t i = 0; i < excludedCount; i++) word &= ~excluded[i][w];
+        out[w] = word;
+    }
+}
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
+
+
+///////////////////////////////////////
+/// ECS Queries ///////////////////////
+///////////////////////////////////////
+
+ECSQuery ECSQueryBegin(ECS *ecs, const uint32_t *required, uint32_t requiredCount, const uint32_t *excluded, uint32_t excludedCount)
+{
+    ECSQuery query;
+    memset(&query, 0, sizeof(query));
+    query.ecs = ecs;
+    query.cursorEnd = UINT32_MAX;
+    query.tick = ecs->changeTick;
+    query.changedTerm = ECS_QUERY_MAX_COMPONENTS;
+
+    if (requiredCount == 0 || requiredCount > ECS_QUERY_MAX_COMPONENTS) return query;
+
+    ComponentDict *components = ECSComponents(ecs);
+    uint32_t driverTerm = 0;
+    for (uint32_t i = 0; i < requiredCount; i++)
+    {
+        if (required[i] >= ecs->currentComponents || components[required[i]].data == 0) return query;
+
+        ComponentDict *component = &components[required[i]];
+        query.components[i] = component;
+        query.entityToIndex[i] = ArenaRelPtr(ArenaRel, component->entityToIndex);
+        query.data[i] = ArenaRelPtr(void, component->data);
+        query.changed[i] = ArenaRelPtr(uint32_t, component->changed);
+        BITSET(query.requiredMask, required[i]);
+
+        if (component->size < components[required[driverTerm]].size) driverTerm = i;
+    }
+
+    for (uint32_t i = 0; i < excludedCount; i++)
+    {
+        if (excluded[i] >= ecs->maxComponents) return query;
+        BITSET(query.excludedMask, excluded[i]);
+    }
+
+    query.requiredCount = requiredCount;
+    query.driverTerm = driverTerm;
+    query.driver = &components[required[driverTerm]];
+    query.driverEntities = ArenaRelPtr(uint32_t, query.driver->indexToEntity);
+    query.signatures = ArenaRelPtr(uint64_t, ecs->entities.eSignatures);
+
+    if (ecs->queryBackend == ECS_QUERY_BIT_PLANES && ecs->bitPlanes != 0 && excludedCount <= ECS_QUERY_MAX_COMPONENTS)
+    {
+        query.backend = ECS_QUERY_BIT_PLANES;
+        for (uint32_t i = 0; i < requiredCount; i++) query.requiredPlanes[i] = ECSBitPlane(ecs, required[i]);
+        for (uint32_t i = 0; i < excludedCount; i++) query.excludedPlanes[i] = ECSBitPlane(ecs, excluded[i]);
+        query.excludedCount = excludedCount;
+
+        // Matches are entity IDs, every component is looked up through its entity to index map
+        query.driverTerm = ECS_QUERY_MAX_COMPONENTS;
+        query.driverEntities = NULL;
+    }
+
+    return query;
+}
+
+// Bit-scans the next combined word with a match into the batch,
+// combining the next block of plane words once the current one is used up
+static bool QueryFetchBitPlanes(ECSQuery *query)
+{
+    // Words past the highest ID ever used are all zero
+    uint32_t wordCount = BITNSLOTS(query->ecs->entities.nextUnused);
+    if (wordCount > query->cursorEnd) wordCount = query->cursorEnd;
+    for (;;)
+    {
+        while (query->planeBlockCursor < query->planeBlockCount)
+        {
+            uint32_t w = query->planeBlockCursor++;
+            uint64_t word = query->planeBlock[w];
+            if (word == 0) continue;
+
+            uint32_t base = (query->planeBlockStart + w) * ECS_SIGNATURE_WORD_BITS;
+            uint32_t count = 0;
+            while (word != 0)
+            {
+                query->batch[count++] = base + (uint32_t)__builtin_ctzll(word);
+                word &= word - 1;
+            }
+
+            query->batchCount = count;
+            query->batchCursor = 0;
+
+            return true;
+        }
+
+        if (query->cursor >= wordCount) return false;
+
+        uint32_t count = wordCount - query->cursor;
+        if (count > ECS_QUERY_PLANE_BLOCK) count = ECS_QUERY_PLANE_BLOCK;
+
+        const uint64_t *required[ECS_QUERY_MAX_COMPONENTS];
+        const uint64_t *excluded[ECS_QUERY_MAX_COMPONENTS];
+        for (uint32_t i = 0; i < query->requiredCount; i++) required[i] = query->requiredPlanes[i] + query->cursor;
+        for (uint32_t i = 0; i < query->excludedCount; i++) excluded[i] = query->excludedPlanes[i] + query->cursor;
+        ECSCombineBitPlanes(required, query->requiredCount, excluded, query->excludedCount, count, query->planeBlock);
+
+        query->planeBlockStart = query->cursor;
+        query->planeBlockCount = count;
+        query->planeBlockCursor = 0;
+        query->cursor += count;
+    }
+}
+
+// Matches driver entities a batch at a time against the query's masks until a batch has a match
+// When the driver is the changed term, entities it has not changed are skipped before their signatures are read
+static bool QueryFetchSparseSets(ECSQuery *query)
+{
+    uint32_t end = (query->driver->size < query->cursorEnd) ? query->driver->size : query->cursorEnd;
+    const uint32_t *changed = (query->changedTerm == query->driverTerm) ? query->changed[query->driverTerm] : NULL;
+    do
+    {
+        if (query->cursor >= end) return false;
+
+        if (changed != NULL)
+        {
+            uint32_t indices[ECS_QUERY_BATCH];
+            uint32_t entities[ECS_QUERY_BATCH];
+            uint32_t count = 0;
+            while (query->cursor < end && count < ECS_QUERY_BATCH)
+            {
+                uint32_t index = query->cursor++;
+                if (changed[index] < query->changedSince) continue;
+
+                indices[count] = index;
+                entities[count++] = query->driverEntities[index];
+            }
+
+            query->batchCount = ECSMatchSignatures(query->signatures, query->ecs->entities.signatureWords,
+                                                   query->requiredMask, query->excludedMask, entities, count, query->batch);
+            for (uint32_t i = 0; i < query->batchCount; i++) query->batch[i] = indices[query->batch[i]];
+        }
+        else
+        {
+            uint32_t count = end - query->cursor;
+            if (count > ECS_QUERY_BATCH) count = ECS_QUERY_BATCH;
+
+            query->batchCount = ECSMatchSignatures(query->signatures, query->ecs->entities.signatureWords,
+                                                   query->requiredMask, query->excludedMask,
+                                                   &query->driverEntities[query->cursor], count, query->batch);
+            for (uint32_t i = 0; i < query->batchCount; i++) query->batch[i] += query->cursor;
+
+            query->cursor += count;
+        }
+        query->batchCursor = 0;
+    } while (query->batchCount == 0);
+
+    return true;
+}
+
+// Drops the entities from the batch whose changed term is older than changedSince
+//
+// Return - Number of entities left in the batch
+static uint32_t FilterChanged(ECSQuery *query)
+{
+    uint32_t term = query->changedTerm;
+    const uint32_t *changed = query->changed[term];
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < query->batchCount; i++)
+    {
+        uint32_t match = query->batch[i];
+        uint32_t index = match;
+        if (term != query->driverTerm)
+        {
+            uint32_t entity = (query->driverEntities != NULL) ? query->driverEntities[match] : match;
+            index = ECSSparsePage(query->entityToIndex[term][entity / ECS_SPARSE_PAGE_SIZE])[entity % ECS_SPARSE_PAGE_SIZE];
+        }
+        if (changed[index] >= query->changedSince) query->batch[kept++] = match;
+    }
+
+    return kept;
+}
+
+void ECSQueryChangedSince(ECSQuery *query, uint32_t term, uint32_t tick)
+{
+    if (query->driver == NULL || term >= query->requiredCount) return;
+
+    query->changedTerm = term;
+    query->changedSince = tick;
+
+    ComponentDict *component = query->components[term];
+    if (query->backend == ECS_QUERY_SPARSE_SETS && term != query->driverTerm &&
+        (uint64_t)component->size <= (uint64_t)query->driver->size * ECS_QUERY_CHANGED_DRIVER_RATIO)
+    {
+        query->driverTerm = term;
+        query->driver = component;
+        query->driverEntities = ArenaRelPtr(uint32_t, component->indexToEntity);
+    }
+}
+
+bool ECSQueryFetch(ECSQuery *query)
+{
+    if (query->driver == NULL) return false;
+
+    do
+    {
+        bool fetched = (query->backend == ECS_QUERY_BIT_PLANES) ? QueryFetchBitPlanes(query) : QueryFetchSparseSets(query);
+        if (!fetched) return false;
+        if (query->changedTerm < query->requiredCount && query->changedTerm != query->driverTerm) query->batchCount = FilterChanged(query);
+    } while (query->batchCount == 0);
+
+    return true;
+}
+
+// What every chunk of an ECSParallelForEach starts from
+typedef struct QueryChunks
+{
+    const ECSQuery *query;
+    ECSQueryFunc fn;
+    void *data;
+} QueryChunks;
+
+static void QueryChunkJob(void *data, uint32_t begin, uint32_t end)
+{
+    QueryChunks *chunks = data;
+    ECSQuery query = *chunks->query;
+    query.cursor = begin;
+    query.cursorEnd = end;
+    query.batchCount = 0;
+    query.batchCursor = 0;
+    query.planeBlockCount = 0;
+    query.planeBlockCursor = 0;
+
+    chunks->fn(&query, chunks->data);
+}
+
+void ECSParallelForEach(JobSystem *jobs, const ECSQuery *query, uint32_t chunkSize, ECSQueryFunc fn, void *data)
+{
+    if (query->driver == NULL) return;
+
+    // Sparse set queries are split by driver index, bit-plane queries by plane word
+    uint32_t end = query->driver->size;
+    if (query->backend == ECS_QUERY_BIT_PLANES)
+    {
+        end = BITNSLOTS(query->ecs->entities.nextUnused);
+        chunkSize = (chunkSize + ECS_SIGNATURE_WORD_BITS - 1) / ECS_SIGNATURE_WORD_BITS;
+    }
+    if (end > query->cursorEnd) end = query->cursorEnd;
+
+    QueryChunks chunks = { query, fn, data };
+    JobParallelFor(jobs, QueryChunkJob, &chunks, query->cursor, end, chunkSize);
+}
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
+
+
+///////////////////////////////////////
+/// ECS Command Buffers ///////////////
+///////////////////////////////////////
+
+void ECSCommandBufferInit(ECSCommandBuffer *buffer, ECS *ecs, Arena *arena)
+{
+    buffer->ecs = ecs;
+    buffer->arena = arena;
+    DynamicArrayInit(buffer->commands, arena);
+    DynamicArrayInit(buffer->values, arena);
+}
+
+uint32_t ECSCommandCreateEntity(ECSCommandBuffer *buffer)
+{
+    return CreateEntity(buffer->ecs);
+}
+
+// Copies one component value, with the common small sizes as fixed size copies the compiler can inline
+static void CopyValue(unsigned char *dest, const unsigned char *src, uint32_t size)
+{
+    switch (size)
+    {
+        case 4: memcpy(dest, src, 4); break;
+        case 8: memcpy(dest, src, 8); break;
+        case 12: memcpy(dest, src, 12); break;
+        case 16: memcpy(dest, src, 16); break;
+        default: memcpy(dest, src, size); break;
+    }
+}
+
+// Every command is checked when recorded, so playback never looks up an ID or component out of range
+static bool RecordCommand(ECSCommandBuffer *buffer, ECSCommandType type, uint32_t entity, uint32_t componentID, const void *value)
+{
+    ECS *ecs = buffer->ecs;
+    if (entity >= ecs->entities.nextUnused) return false;
+    if (type != ECS_COMMAND_REMOVE_ENTITY && componentID >= ecs->maxComponents) return false;
+
+    // Generations are odd while the ID is in use
+    uint32_t generation = ArenaRelPtr(uint16_t, ecs->entities.generations)[entity];
+    if ((generation & 1) == 0) return false;
+
+    ECSCommand command = { type, (generation << ENTITY_INDEX_BITS) | entity, componentID, UINT32_MAX };
+    uint32_t valueSize = (type == ECS_COMMAND_ADD_COMPONENT) ? ECSComponents(ecs)[componentID].valueSize : 0;
+    if (value != NULL && valueSize > 0)
+    {
+        command.valueOffset = buffer->values.len;
+        if (!DynamicArrayResize(buffer->values, buffer->values.len + valueSize)) return false;
+        CopyValue(&buffer->values.values[command.valueOffset], value, valueSize);
+    }
+
+    return DynamicArrayPush(buffer->commands, command);
+}
+
+bool ECSCommandAddComponent(ECSCommandBuffer *buffer, uint32_t entity, uint32_t componentID, const void *value)
+{
+    return RecordCommand(buffer, ECS_COMMAND_ADD_COMPONENT, entity, componentID, value);
+}
+
+bool ECSCommandRemoveComponent(ECSCommandBuffer *buffer, uint32_t entity, uint32_t componentID)
+{
+    return RecordCommand(buffer, ECS_COMMAND_REMOVE_COMPONENT, entity, componentID, NULL);
+}
+
+bool ECSCommandRemoveEntity(ECSCommandBuffer *buffer, uint32_t entity)
+{
+    return RecordCommand(buffer, ECS_COMMAND_REMOVE_ENTITY, entity, 0, NULL);
+}
+
+// Applies one component's commands, given as indices into the buffer in the order they were recorded.
+// The component is looked up once and its dense array grown once for all of the adds,
+// which are then associated in a tight loop instead of a call each
+static bool PlaybackComponent(ECSCommandBuffer *buffer, uint32_t componentID, const uint32_t *order, uint32_t count)
+{
+    ECS *ecs = buffer->ecs;
+    ComponentDict *component = &ECSComponents(ecs)[componentID];
+    const ECSCommand *commands = buffer->commands.values;
+
+    uint32_t adds = 0;
+    for (uint32_t i = 0; i < count; i++) adds += commands[order[i]].type == ECS_COMMAND_ADD_COMPONENT;
+    if (!ReserveComponentDict(component, ecs->arena, component->size + adds)) return false;
+
+    unsigned char *values = ArenaRelPtr(unsigned char, component->data);
+    uint32_t valueSize = component->valueSize;
+    uint32_t *indexToEntity = ArenaRelPtr(uint32_t, component->indexToEntity);
+    uint32_t *changed = ArenaRelPtr(uint32_t, component->changed);
+    ArenaRel *pages = ArenaRelPtr(ArenaRel, component->entityToIndex);
+    uint32_t *emptyPage = ArenaRelPtr(uint32_t, component->emptyPage);
+    uint64_t *signatures = ArenaRelPtr(uint64_t, ecs->entities.eSignatures);
+    uint32_t signatureWords = ecs->entities.signatureWords;
+    uint64_t *plane = (ecs->bitPlanes != 0) ? ECSBitPlane(ecs, componentID) : NULL;
+    uint16_t *generations = ArenaRelPtr(uint16_t, ecs->entities.generations);
+    bool applied = true;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const ECSCommand *command = &commands[order[i]];
+        uint32_t entity = EntityHandleIndex(command->entity);
+        // Handles are only recorded for live entities, so a matching generation means the same entity is still alive
+        if (generations[entity] != EntityHandleGeneration(command->entity))
+        {
+            applied = false;
+            continue;
+        }
+
+        if (command->type == ECS_COMMAND_REMOVE_COMPONENT)
+        {
+            applied = ECSRemoveComponent(entity, ecs, componentID) && applied;
+            continue;
+        }
+
+        uint32_t *page = ECSSparsePage(pages[entity / ECS_SPARSE_PAGE_SIZE]);
+        uint32_t *slot = (page != emptyPage) ? &page[entity % ECS_SPARSE_PAGE_SIZE] : WritableSlot(component, ecs->arena, entity);
+        if (slot == NULL)
+        {
+            applied = false;
+            continue;
+        }
+
+        // Already having the component just overwrites its value
+        if (*slot == UINT32_MAX)
+        {
+            *slot = component->size;
+            indexToEntity[component->size] = entity;
+            component->size++;
+            BITSET(signatures + (uint64_t)entity * signatureWords, componentID);
+            if (plane != NULL) BITSET(plane, entity);
+        }
+        if (values != NULL && command->valueOffset != UINT32_MAX)
+        {
+            CopyValue(values + (uint64_t)*slot * valueSize, &buffer->values.values[command->valueOffset], valueSize);
+        }
+        changed[*slot] = ecs->changeTick;
+    }
+
+    return applied;
+}
+
+// Removes every entity in a batch. Components that lose at least 1 / ECS_COMMAND_COMPACT_FRACTION of their
+// entities are compacted in one pass over their dense array instead of a swap-remove per entity,
+// which keeps the survivors in order and reads their data front to back
+#define ECS_COMMAND_COMPACT_FRACTION 8
+
+static bool PlaybackRemovals(ECSCommandBuffer *buffer, Arena *scratch)
+{
+    ECS *ecs = buffer->ecs;
+    EntityData *data = &ecs->entities;
+    const ECSCommand *commands = buffer->commands.values;
+    uint32_t count = buffer->commands.len;
+    uint16_t *generations = ArenaRelPtr(uint16_t, data->generations);
+
+    uint32_t *removed = PushArray(scratch, uint32_t, count);
+    uint32_t *perComponent = PushArrayZero(scratch, uint32_t, ecs->maxComponents);
+    if (removed == NULL || perComponent == NULL) return false;
+
+    // Retire the IDs first, an entity recorded twice is no longer alive the second time
+    bool applied = true;
+    uint32_t removedCount = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (commands[i].type != ECS_COMMAND_REMOVE_ENTITY) continue;
+
+        uint32_t entity = EntityHandleIndex(commands[i].entity);
+        if (generations[entity] != EntityHandleGeneration(commands[i].entity) || !IDEnqueue(&data->eIDs, entity))
+        {
+            applied = false;
+            continue;
+        }
+        generations[entity] = (generations[entity] + 1) & ENTITY_GENERATION_MASK;
+        data->currentEntities--;
+        removed[removedCount++] = entity;
+
+        uint64_t *signature = GetSignature(data, entity);
+        for (uint32_t w = 0; w < data->signatureWords; w++)
+        {
+            for (uint64_t word = signature[w]; word != 0; word &= word - 1)
+            {
+                perComponent[w * ECS_SIGNATURE_WORD_BITS + (uint32_t)__builtin_ctzll(word)]++;
+            }
+        }
+    }
+
+    for (uint32_t c = 0; c < ecs->maxComponents; c++)
+    {
+        if (perComponent[c] == 0) continue;
+
+        ComponentDict *component = &ECSComponents(ecs)[c];
+        if ((uint64_t)perComponent[c] * ECS_COMMAND_COMPACT_FRACTION < component->size)
+        {
+            for (uint32_t i = 0; i < removedCount; i++)
+            {
+                if (BITTEST(GetSignature(data, removed[i]), c)) ECSRemoveComponent(removed[i], ecs, c);
+            }
+            continue;
+        }
+
+        uint64_t *plane = (ecs->bitPlanes != 0) ? ECSBitPlane(ecs, c) : NULL;
+        for (uint32_t i = 0; i < removedCount; i++)
+        {
+            uint64_t *signature = GetSignature(data, removed[i]);
+            if (!BITTEST(signature, c)) continue;
+
+            ComponentDictIndex(component, removed[i]) = -1;
+            BITCLEAR(signature, c);
+            if (plane != NULL) BITCLEAR(plane, removed[i]);
+        }
+
+        uint32_t *indexToEntity = ArenaRelPtr(uint32_t, component->indexToEntity);
+        uint32_t *changed = ArenaRelPtr(uint32_t, component->changed);
+        unsigned char *values = ArenaRelPtr(unsigned char, component->data);
+        uint32_t valueSize = component->valueSize;
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < component->size; i++)
+        {
+            uint32_t entity = indexToEntity[i];
+            uint32_t *slot = &ComponentDictIndex(component, entity);
+            if (*slot == UINT32_MAX) continue;
+
+            if (kept != i)
+            {
+                indexToEntity[kept] = entity;
+                changed[kept] = changed[i];
+                *slot = kept;
+                if (values != NULL) memcpy(values + (uint64_t)kept * valueSize, values + (uint64_t)i * valueSize, valueSize);
+            }
+            kept++;
+        }
+        component->size = kept;
+    }
+
+    return applied;
+}
+
+bool ECSCommandBufferPlayback(ECSCommandBuffer *buffer)
+{
+    ECS *ecs = buffer->ecs;
+    const ECSCommand *commands = buffer->commands.values;
+    uint32_t count = buffer->commands.len;
+    if (count == 0) return true;
+
+    Arena *conflicts[] = { buffer->arena, ecs->arena };
+    ArenaTemp scratch = ArenaScratchBegin(conflicts, sizeof(conflicts) / sizeof(conflicts[0]));
+    if (scratch.arena == NULL) return false;
+
+    // Counting sort of the component commands by component ID, stable so each component's keep their order
+    uint32_t *starts = PushArrayZero(scratch.arena, uint32_t, ecs->maxComponents + 1);
+    uint32_t *cursors = PushArray(scratch.arena, uint32_t, ecs->maxComponents);
+    uint32_t *order = PushArray(scratch.arena, uint32_t, count);
+    if (starts == NULL || cursors == NULL || order == NULL)
+    {
+        ArenaScratchEnd(scratch);
+        return false;
+    }
+
+    bool removesEntities = false;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (commands[i].type != ECS_COMMAND_REMOVE_ENTITY) starts[commands[i].componentID + 1]++;
+        else removesEntities = true;
+    }
+    for (uint32_t c = 0; c < ecs->maxComponents; c++)
+    {
+        starts[c + 1] += starts[c];
+        cursors[c] = starts[c];
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (commands[i].type != ECS_COMMAND_REMOVE_ENTITY) order[cursors[commands[i].componentID]++] = i;
+    }
+
+    bool applied = true;
+    for (uint32_t c = 0; c < ecs->maxComponents; c++)
+    {
+        if (starts[c + 1] == starts[c]) continue;
+        applied = PlaybackComponent(buffer, c, &order[starts[c]], starts[c + 1] - starts[c]) && applied;
+    }
+
+    if (removesEntities) applied = PlaybackRemovals(buffer, scratch.arena) && applied;
+
+    ArenaScratchEnd(scratch);
+
+    DynamicArrayClear(buffer->commands);
+    DynamicArrayClear(buffer->values);
+
+    return applied;
+}
+
 ///////////////////////////////////////
 ///////////////////////////////////////
 ///////////////////////////////////////
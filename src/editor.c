@@ -9,9 +9,11 @@
 #include "../include/arena.h"
 #include "../include/dynamicarray.h"
 
+DynamicArrayDefine(DynamicColors, Color);
+
 bool TileSelector();
 void RenderGrid(Vector2Int dimensions, int cellSize, Color color);
-void RenderTiles(Vector2Int dimensions, int32_t cellSize, DynamicTiles tilemap);
+void RenderTiles(Vector2Int dimensions, int32_t cellSize, DynamicColors tilemap);
 void CameraControls(Camera2D *camera);
 
 int main(void)
@@ -32,12 +34,13 @@ int main(void)
     camera.zoom = 1.0f;
 
     Vector2Int mapDimensions = { 24, 24 };
-    DynamicTiles tilemap;
-    InitDynamicArray(tilemap, Color);
-    DynamicResize(tilemap, Color, mapDimensions.x * mapDimensions.y);
+    Arena *tileArena = ArenaAlloc();
+    DynamicColors tilemap;
+    DynamicArrayInit(tilemap, tileArena);
+    if (!DynamicArrayReserve(tilemap, mapDimensions.x * mapDimensions.y)) return 1;
     for (int i = 0; i < mapDimensions.x * mapDimensions.y; i++)
     {
-        AppendArrayDynamic(tilemap, BLACK);
+        DynamicArrayPush(tilemap, BLACK);
     }
    
     while (!WindowShouldClose())
@@ -90,6 +93,8 @@ int main(void)
 
     // Raylib window shutdown
     CloseWindow();
+
+    ArenaDealloc(tileArena);
 }
 
 bool TileSelector()
@@ -150,7 +155,7 @@ void RenderGrid(Vector2Int dimensions, int32_t cellSize, Color color)
     }
 }
 
-void RenderTiles(Vector2Int dimensions, int32_t cellSize, DynamicTiles tilemap)
+void RenderTiles(Vector2Int dimensions, int32_t cellSize, DynamicColors tilemap)
 {
     for (int i = 0; i < dimensions.y; i++)
     {
@@ -7,28 +7,48 @@
 // uses arena allocator passes as argument instead of malloc
 bool EventPoolInit(EventPool *events, Arena *arena, uint32_t maxEvents)
 {
+    const char *previousTag = ArenaSetTag(arena, "events");
+
     events->events = PushArray(arena, Event, maxEvents);
     events->IDtoIndices.hashmap = PushArray(arena, EventHashmap *, maxEvents);
     events->IDtoIndices.sizes = PushArray(arena, uint32_t, maxEvents);
     for (int i = 0; i < maxEvents; i++)
     {
-        events->events[i].strValue = PushArray(arena, char, EVENT_VALUE_SIZE);
+        events->events[i].strValue = NULL;
+        events->events[i].strSize = 0;
         events->IDtoIndices.hashmap[i] = PushArray(arena, EventHashmap, maxEvents);
         events->IDtoIndices.sizes[i] = 0;
     }
     events->maxEvents = maxEvents;
     events->numEvents = 0;
 
-    return true;
+    ArenaSetTag(arena, previousTag);
+
+    return PoolInit(&events->strings, arena);
 }
 
 // Publishes an event onto the event pool queue, uses arguments to format new event,
-// strvalue size limit set at EVENT_VALUE_SIZE defined at the top of event.h
+// strValue is copied into a block sized to fit it, up to EVENT_VALUE_SIZE defined at the top of event.h
 void EventPoolPublish(EventPool *events, uint32_t eventID, char *strValue, uint32_t intValue)
 {
-    events->events[events->numEvents].id = eventID;
-    events->events[events->numEvents].intValue = intValue;
-    strcpy(events->events[events->numEvents].strValue, strValue);
+    Event *event = &events->events[events->numEvents];
+    event->id = eventID;
+    event->intValue = intValue;
+
+    uint64_t strSize = strlen(strValue) + 1;
+    if (strSize > EVENT_VALUE_SIZE) strSize = EVENT_VALUE_SIZE;
+
+    event->strValue = PoolAlloc(&events->strings, strSize);
+    event->strSize = (event->strValue != NULL) ? strSize : 0;
+    if (event->strValue != NULL)
+    {
+        memcpy(event->strValue, strValue, strSize - 1);
+        event->strValue[strSize - 1] = '\0';
+    }
+    else
+    {
+        event->strValue = "";
+    }
 
     uint32_t size = events->IDtoIndices.sizes[eventID];
     events->IDtoIndices.hashmap[eventID][size] = events->numEvents;
@@ -41,6 +61,12 @@ void EventPoolPublish(EventPool *events, uint32_t eventID, char *strValue, uint3
 // so the old events are overwritten and the queued events are processed next frame
 void EventPoolIterate(EventPool *events)
 {
+    for (int i = 0; i < events->numEvents; i++)
+    {
+        if (events->events[i].strSize > 0) PoolFree(&events->strings, events->events[i].strValue, events->events[i].strSize);
+        events->events[i].strSize = 0;
+    }
+
     events->numEvents = 0;
     for (int i = 0; i < events->maxEvents; i++)
     {
@@ -48,22 +74,15 @@ void EventPoolIterate(EventPool *events)
     }
 }
 
-// Subscribes to an event type, searching the current events array
-// for the subscribed event ID
-
-// Fow now, duplicate event types are ignored
-// This can be changed if/when multiple events with the same ID need to be handled
+// Subscribes to an event type, returning the indices in the current events array
+// of every event published with the subscribed event ID
+//
+// The returned array belongs to the event pool and is only valid until the next EventPoolIterate
 // 
-// Returns -1 when event could not be found
+// Returns NULL when event could not be found
 uint32_t *EventPoolSubscribe(EventPool *events, uint32_t eventID)
 {
     if (events->IDtoIndices.sizes[eventID] == 0) return NULL;
 
-    uint32_t *indices = malloc(sizeof(*indices) * events->IDtoIndices.sizes[eventID]);
-    for (int i = 0; i < events->IDtoIndices.sizes[eventID]; i++)
-    {
-        indices[i] = events->IDtoIndices.hashmap[eventID][i];
-    }
-
-    return indices;
+    return events->IDtoIndices.hashmap[eventID];
 }
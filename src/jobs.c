@@ -0,0 +1,284 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../include/jobs.h"
+#include "../include/platform.h"
+
+// The job system thread running on this thread, NULL on threads that are not part of one
+static _Thread_local JobThread *currentThread = NULL;
+
+///////////////////////////////////////
+/// Job Queues ////////////////////////
+///////////////////////////////////////
+
+// Owner only
+//
+// Return - Boolean for success or failure, fails if the deque is full
+static bool QueuePush(JobQueue *queue, Job *job)
+{
+    int64_t bottom = __atomic_load_n(&queue->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&queue->top, __ATOMIC_ACQUIRE);
+    if (bottom - top >= JOB_QUEUE_SIZE) return false;
+
+    __atomic_store_n(&queue->jobs[bottom & (JOB_QUEUE_SIZE - 1)], job, __ATOMIC_RELAXED);
+    __atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+// Owner only, takes the newest job
+//
+// Return - The job, NULL if the deque is empty or a thief took the last one
+static Job *QueuePop(JobQueue *queue)
+{
+    int64_t bottom = __atomic_load_n(&queue->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&queue->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&queue->top, __ATOMIC_RELAXED);
+
+    if (top > bottom)
+    {
+        __atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    Job *job = __atomic_load_n(&queue->jobs[bottom & (JOB_QUEUE_SIZE - 1)], __ATOMIC_RELAXED);
+    if (top == bottom)
+    {
+        // Last job, race thieves for it
+        if (!__atomic_compare_exchange_n(&queue->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) job = NULL;
+        __atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+
+    return job;
+}
+
+// Any thread, takes the oldest job
+//
+// Return - The job, NULL if the deque is empty or another thread got to it first
+static Job *QueueSteal(JobQueue *queue)
+{
+    int64_t top = __atomic_load_n(&queue->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&queue->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom) return NULL;
+
+    Job *job = __atomic_load_n(&queue->jobs[top & (JOB_QUEUE_SIZE - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&queue->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) return NULL;
+
+    return job;
+}
+
+///////////////////////////////////////
+/// Running Jobs //////////////////////
+///////////////////////////////////////
+
+// The job is copied out and its slot given back before it runs, a job waiting on jobs it added
+// could otherwise hold on to its slot until the pool wraps around to it and nothing can be added
+static void RunJob(Job *job)
+{
+    Job taken = *job;
+    __atomic_store_n(&job->taken, 1, __ATOMIC_RELEASE);
+
+    taken.func(taken.data, taken.begin, taken.end);
+    if (taken.counter != NULL) __atomic_sub_fetch(&taken.counter->pending, 1, __ATOMIC_ACQ_REL);
+}
+
+// The thread's own newest job, otherwise the oldest job of another thread, starting from a random one
+static Job *FindJob(JobThread *self)
+{
+    Job *job = QueuePop(&self->queue);
+    if (job != NULL) return job;
+
+    JobSystem *jobs = self->system;
+    self->random ^= self->random << 13;
+    self->random ^= self->random >> 17;
+    self->random ^= self->random << 5;
+    uint32_t start = self->random % jobs->threadCount;
+    for (uint32_t i = 0; i < jobs->threadCount; i++)
+    {
+        uint32_t victim = (start + i) % jobs->threadCount;
+        if (victim == self->index) continue;
+
+        job = QueueSteal(&jobs->threads[victim].queue);
+        if (job != NULL) return job;
+    }
+
+    return NULL;
+}
+
+// Take one of the sleepers, so only one job adder posts for each one
+static bool ClaimSleeper(JobSystem *jobs)
+{
+    uint32_t sleeping = __atomic_load_n(&jobs->sleeping, __ATOMIC_SEQ_CST);
+    while (sleeping > 0)
+    {
+        if (__atomic_compare_exchange_n(&jobs->sleeping, &sleeping, sleeping - 1, true, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) return true;
+    }
+    return false;
+}
+
+// Workers look for jobs for a while when they run out, then sleep until JobAdd wakes them.
+// A worker counts itself as sleeping before its last look, and JobAdd checks for sleepers after pushing,
+// so one of the two always sees the other and no job is left with every worker asleep
+static void WorkerMain(void *arg)
+{
+    JobThread *self = arg;
+    JobSystem *jobs = self->system;
+    currentThread = self;
+
+    while (!__atomic_load_n(&jobs->quit, __ATOMIC_ACQUIRE))
+    {
+        Job *job = NULL;
+        for (uint32_t spin = 0; spin < JOB_IDLE_SPINS && job == NULL; spin++)
+        {
+            job = FindJob(self);
+            if (job == NULL) PlatformThreadYield();
+        }
+
+        if (job == NULL)
+        {
+            __atomic_add_fetch(&jobs->sleeping, 1, __ATOMIC_SEQ_CST);
+            job = FindJob(self);
+            // A job adder that already claimed this worker has posted, or is about to, so that post is used up
+            if (job == NULL || !ClaimSleeper(jobs)) PlatformSemaphoreWait(&jobs->wake);
+        }
+
+        if (job != NULL) RunJob(job);
+    }
+
+    // Jobs that used scratch memory on this thread created its scratch arenas
+    ArenaScratchRelease();
+    currentThread = NULL;
+}
+
+///////////////////////////////////////
+/// Job System ////////////////////////
+///////////////////////////////////////
+
+bool JobSystemInit(JobSystem *jobs, Arena *arena, uint32_t workerCount)
+{
+    memset(jobs, 0, sizeof(JobSystem));
+    if (workerCount + 1 > JOB_MAX_THREADS) return false;
+
+    jobs->threads = PushArrayTagged(arena, JobThread, workerCount + 1, "jobs");
+    if (jobs->threads == NULL) return false;
+    if (!PlatformSemaphoreCreate(&jobs->wake)) return false;
+
+    for (uint32_t i = 0; i <= workerCount; i++)
+    {
+        JobThread *thread = &jobs->threads[i];
+        thread->system = jobs;
+        thread->index = i;
+        thread->queue.top = 0;
+        thread->queue.bottom = 0;
+        thread->nextJob = 0;
+        thread->random = 2463534242u + i * 2654435761u;
+        for (uint32_t j = 0; j < JOB_QUEUE_SIZE; j++) thread->pool[j].taken = 1;
+    }
+
+    // Every deque is ready before the first worker starts stealing from them
+    jobs->threadCount = workerCount + 1;
+    currentThread = &jobs->threads[0];
+    for (uint32_t i = 1; i <= workerCount; i++)
+    {
+        if (PlatformThreadCreate(&jobs->threads[i].thread, WorkerMain, &jobs->threads[i])) continue;
+
+        __atomic_store_n(&jobs->quit, true, __ATOMIC_RELEASE);
+        PlatformSemaphorePost(&jobs->wake, i - 1);
+        for (uint32_t j = 1; j < i; j++) PlatformThreadJoin(&jobs->threads[j].thread);
+        PlatformSemaphoreDestroy(&jobs->wake);
+        currentThread = NULL;
+        jobs->threads = NULL;
+        jobs->threadCount = 0;
+        return false;
+    }
+
+    return true;
+}
+
+void JobSystemRelease(JobSystem *jobs)
+{
+    if (jobs->threads == NULL) return;
+
+    __atomic_store_n(&jobs->quit, true, __ATOMIC_RELEASE);
+    PlatformSemaphorePost(&jobs->wake, jobs->threadCount - 1);
+    for (uint32_t i = 1; i < jobs->threadCount; i++) PlatformThreadJoin(&jobs->threads[i].thread);
+    PlatformSemaphoreDestroy(&jobs->wake);
+
+    if (currentThread == &jobs->threads[0]) currentThread = NULL;
+    jobs->threads = NULL;
+    jobs->threadCount = 0;
+}
+
+void JobAdd(JobSystem *jobs, JobFunc func, void *data, uint32_t begin, uint32_t end, JobCounter *counter)
+{
+    JobThread *self = currentThread;
+    if (self == NULL || self->system != jobs)
+    {
+        func(data, begin, end);
+        return;
+    }
+
+    // A slot whose job has not been taken yet is still in some deque, run jobs until it has
+    Job *job = &self->pool[self->nextJob];
+    while (!__atomic_load_n(&job->taken, __ATOMIC_ACQUIRE))
+    {
+        Job *other = FindJob(self);
+        if (other != NULL) RunJob(other);
+        else PlatformThreadYield();
+    }
+    self->nextJob = (self->nextJob + 1) & (JOB_QUEUE_SIZE - 1);
+
+    job->func = func;
+    job->data = data;
+    job->begin = begin;
+    job->end = end;
+    job->counter = counter;
+    job->taken = 0;
+    if (counter != NULL) __atomic_add_fetch(&counter->pending, 1, __ATOMIC_ACQ_REL);
+
+    if (!QueuePush(&self->queue, job))
+    {
+        RunJob(job);
+        return;
+    }
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (ClaimSleeper(jobs)) PlatformSemaphorePost(&jobs->wake, 1);
+}
+
+void JobWait(JobSystem *jobs, JobCounter *counter)
+{
+    JobThread *self = currentThread;
+    while (__atomic_load_n(&counter->pending, __ATOMIC_ACQUIRE) > 0)
+    {
+        Job *job = (self != NULL && self->system == jobs) ? FindJob(self) : NULL;
+        if (job != NULL) RunJob(job);
+        else PlatformThreadYield();
+    }
+}
+
+void JobParallelFor(JobSystem *jobs, JobFunc func, void *data, uint32_t begin, uint32_t end, uint32_t chunkSize)
+{
+    if (chunkSize == 0) chunkSize = 1;
+    if (end <= begin) return;
+    if (end - begin <= chunkSize)
+    {
+        func(data, begin, end);
+        return;
+    }
+
+    JobCounter counter = { 0 };
+    uint32_t chunkEnd;
+    for (uint32_t chunk = begin; chunk < end; chunk = chunkEnd)
+    {
+        chunkEnd = (end - chunk <= chunkSize) ? end : chunk + chunkSize;
+        JobAdd(jobs, func, data, chunk, chunkEnd, &counter);
+    }
+    JobWait(jobs, &counter);
+}
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
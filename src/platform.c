@@ -0,0 +1,398 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../include/platform.h"
+
+// Page size never changes while running, so it is only asked for once
+static uint64_t cachedPageSize = 0;
+
+// Writes one byte per page, used to prefault when the OS has no call for it
+static void TouchPages(void *ptr, uint64_t size)
+{
+    volatile unsigned char *bytes = ptr;
+    uint64_t pageSize = PlatformPageSize();
+    for (uint64_t i = 0; i < size; i += pageSize)
+    {
+        bytes[i] = bytes[i];
+    }
+}
+
+#ifdef _WIN32
+
+#include <limits.h>
+#include <memoryapi.h>
+#include <profileapi.h>
+#include <processthreadsapi.h>
+#include <synchapi.h>
+#include <handleapi.h>
+#include <sysinfoapi.h>
+#include <psapi.h>
+#include "../include/windows_utils.h"
+
+///////////////////////////////////////
+// Virtual Memory /////////////////////
+///////////////////////////////////////
+
+uint64_t PlatformPageSize()
+{
+    if (cachedPageSize == 0) cachedPageSize = GetPageSize();
+    return cachedPageSize;
+}
+
+// Large pages on Windows need SeLockMemoryPrivilege and cannot be reserved
+// without also being committed, so the page mode is ignored here
+void *PlatformReserve(uint64_t size, PlatformPageMode mode)
+{
+    (void)mode;
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_READWRITE);
+}
+
+bool PlatformCommit(void *ptr, uint64_t size)
+{
+    return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+bool PlatformDecommit(void *ptr, uint64_t size)
+{
+    return VirtualFree(ptr, size, MEM_DECOMMIT) != 0;
+}
+
+void PlatformPrefault(void *ptr, uint64_t size)
+{
+    TouchPages(ptr, size);
+}
+
+// Without a way to map a file over part of a reservation the file is just read in
+bool PlatformMapFile(void *ptr, uint64_t size, const char *path)
+{
+    if (!PlatformCommit(ptr, size)) return false;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return false;
+
+    bool read = fread(ptr, 1, size, file) == size;
+    fclose(file);
+
+    return read;
+}
+
+void PlatformRelease(void *ptr, uint64_t size)
+{
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+uint64_t PlatformResidentBytes()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+
+    return counters.WorkingSetSize;
+}
+
+///////////////////////////////////////
+// Threads ////////////////////////////
+///////////////////////////////////////
+
+static DWORD WINAPI ThreadEntry(LPVOID param)
+{
+    PlatformThread *thread = param;
+    thread->func(thread->arg);
+    return 0;
+}
+
+bool PlatformThreadCreate(PlatformThread *thread, PlatformThreadFunc func, void *arg)
+{
+    thread->func = func;
+    thread->arg = arg;
+
+    HANDLE handle = CreateThread(NULL, 0, ThreadEntry, thread, 0, NULL);
+    thread->handle = (uintptr_t)handle;
+
+    return handle != NULL;
+}
+
+void PlatformThreadJoin(PlatformThread *thread)
+{
+    WaitForSingleObject((HANDLE)thread->handle, INFINITE);
+    CloseHandle((HANDLE)thread->handle);
+}
+
+void PlatformThreadYield()
+{
+    SwitchToThread();
+}
+
+uint32_t PlatformProcessorCount()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+bool PlatformSemaphoreCreate(PlatformSemaphore *semaphore)
+{
+    HANDLE handle = CreateSemaphoreA(NULL, 0, LONG_MAX, NULL);
+    semaphore->handle = (uintptr_t)handle;
+
+    return handle != NULL;
+}
+
+void PlatformSemaphoreWait(PlatformSemaphore *semaphore)
+{
+    WaitForSingleObject((HANDLE)semaphore->handle, INFINITE);
+}
+
+void PlatformSemaphorePost(PlatformSemaphore *semaphore, uint32_t count)
+{
+    if (count > 0) ReleaseSemaphore((HANDLE)semaphore->handle, (LONG)count, NULL);
+}
+
+void PlatformSemaphoreDestroy(PlatformSemaphore *semaphore)
+{
+    CloseHandle((HANDLE)semaphore->handle);
+}
+
+///////////////////////////////////////
+// Timing /////////////////////////////
+///////////////////////////////////////
+
+uint64_t PlatformTimeNs()
+{
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t)((counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+                      ((counter.QuadPart % frequency.QuadPart) * 1000000000ULL) / frequency.QuadPart);
+}
+
+#else
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+///////////////////////////////////////
+// Virtual Memory /////////////////////
+///////////////////////////////////////
+
+uint64_t PlatformPageSize()
+{
+    if (cachedPageSize == 0) cachedPageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+    return cachedPageSize;
+}
+
+void *PlatformReserve(uint64_t size, PlatformPageMode mode)
+{
+#ifdef MAP_HUGETLB
+    // Explicit huge pages come out of the hugetlbfs pool, which is reserved up front,
+    // if the pool can not cover the whole range fall back to transparent huge pages
+    if (mode == PLATFORM_PAGES_HUGE_EXPLICIT)
+    {
+        void *ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) return ptr;
+    }
+#endif
+    if (mode == PLATFORM_PAGES_HUGE_EXPLICIT) mode = PLATFORM_PAGES_HUGE;
+
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+
+    // Over-reserve by one huge page so the range can be trimmed down to huge page alignment,
+    // otherwise the kernel can not back the first and last partial 2MB with huge pages
+    uint64_t align = (mode == PLATFORM_PAGES_HUGE) ? PLATFORM_HUGE_PAGE_SIZE : 0;
+    unsigned char *raw = mmap(NULL, size + align, PROT_NONE, flags, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    if (align == 0) return raw;
+
+    unsigned char *base = (unsigned char *)(((uintptr_t)raw + align - 1) & ~(uintptr_t)(align - 1));
+    uint64_t head = base - raw;
+    uint64_t tail = align - head;
+    if (head > 0) munmap(raw, head);
+    if (tail > 0) munmap(base + size, tail);
+
+#ifdef MADV_HUGEPAGE
+    madvise(base, size, MADV_HUGEPAGE);
+#endif
+
+    return base;
+}
+
+bool PlatformCommit(void *ptr, uint64_t size)
+{
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+// MADV_DONTNEED drops the pages from RSS right away, PROT_NONE makes
+// any use of the range after decommitting fault instead of silently recommitting
+bool PlatformDecommit(void *ptr, uint64_t size)
+{
+    if (madvise(ptr, size, MADV_DONTNEED) != 0) return false;
+    return mprotect(ptr, size, PROT_NONE) == 0;
+}
+
+void PlatformPrefault(void *ptr, uint64_t size)
+{
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(ptr, size, MADV_POPULATE_WRITE) == 0) return;
+#endif
+    TouchPages(ptr, size);
+}
+
+bool PlatformMapFile(void *ptr, uint64_t size, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    // MAP_FIXED replaces the reserved pages in place, the rest of the reservation is untouched
+    void *mapped = mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    close(fd);
+
+    return mapped != MAP_FAILED;
+}
+
+void PlatformRelease(void *ptr, uint64_t size)
+{
+    munmap(ptr, size);
+}
+
+// Linux only, other systems without /proc report 0
+uint64_t PlatformResidentBytes()
+{
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL) return 0;
+
+    unsigned long long totalPages = 0, residentPages = 0;
+    int read = fscanf(statm, "%llu %llu", &totalPages, &residentPages);
+    fclose(statm);
+
+    return (read == 2) ? residentPages * PlatformPageSize() : 0;
+}
+
+///////////////////////////////////////
+// Threads ////////////////////////////
+///////////////////////////////////////
+
+_Static_assert(sizeof(pthread_t) <= sizeof(uintptr_t), "pthread_t must fit in PlatformThread.handle");
+
+static void *ThreadEntry(void *param)
+{
+    PlatformThread *thread = param;
+    thread->func(thread->arg);
+    return NULL;
+}
+
+bool PlatformThreadCreate(PlatformThread *thread, PlatformThreadFunc func, void *arg)
+{
+    thread->func = func;
+    thread->arg = arg;
+
+    pthread_t handle;
+    if (pthread_create(&handle, NULL, ThreadEntry, thread) != 0) return false;
+    thread->handle = (uintptr_t)handle;
+
+    return true;
+}
+
+void PlatformThreadJoin(PlatformThread *thread)
+{
+    pthread_join((pthread_t)thread->handle, NULL);
+}
+
+void PlatformThreadYield()
+{
+    sched_yield();
+}
+
+uint32_t PlatformProcessorCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t)count : 1;
+}
+
+// Unnamed POSIX semaphores are missing on some systems, so this is a mutex and condition variable
+typedef struct PosixSemaphore
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t count;
+} PosixSemaphore;
+
+bool PlatformSemaphoreCreate(PlatformSemaphore *semaphore)
+{
+    PosixSemaphore *posix = malloc(sizeof(PosixSemaphore));
+    semaphore->handle = (uintptr_t)posix;
+    if (posix == NULL) return false;
+
+    posix->count = 0;
+    if (pthread_mutex_init(&posix->mutex, NULL) != 0)
+    {
+        free(posix);
+        return false;
+    }
+    if (pthread_cond_init(&posix->cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&posix->mutex);
+        free(posix);
+        return false;
+    }
+
+    return true;
+}
+
+void PlatformSemaphoreWait(PlatformSemaphore *semaphore)
+{
+    PosixSemaphore *posix = (PosixSemaphore *)semaphore->handle;
+    pthread_mutex_lock(&posix->mutex);
+    while (posix->count == 0) pthread_cond_wait(&posix->cond, &posix->mutex);
+    posix->count--;
+    pthread_mutex_unlock(&posix->mutex);
+}
+
+void PlatformSemaphorePost(PlatformSemaphore *semaphore, uint32_t count)
+{
+    if (count == 0) return;
+
+    PosixSemaphore *posix = (PosixSemaphore *)semaphore->handle;
+    pthread_mutex_lock(&posix->mutex);
+    posix->count += count;
+    if (count == 1) pthread_cond_signal(&posix->cond);
+    else pthread_cond_broadcast(&posix->cond);
+    pthread_mutex_unlock(&posix->mutex);
+}
+
+void PlatformSemaphoreDestroy(PlatformSemaphore *semaphore)
+{
+    PosixSemaphore *posix = (PosixSemaphore *)semaphore->handle;
+    if (posix == NULL) return;
+
+    pthread_cond_destroy(&posix->cond);
+    pthread_mutex_destroy(&posix->mutex);
+    free(posix);
+    semaphore->handle = 0;
+}
+
+///////////////////////////////////////
+// Timing /////////////////////////////
+///////////////////////////////////////
+
+uint64_t PlatformTimeNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#endif
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
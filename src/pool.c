@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdalign.h>
+#include "../include/pool.h"
+
+///////////////////////////////////////
+// Pool Allocator /////////////////////
+///////////////////////////////////////
+
+// Maps a size to the index of the smallest class that fits it
+static uint32_t PoolSizeClass(uint64_t size)
+{
+    if (size <= POOL_MIN_SIZE) return 0;
+
+    // Position of the highest set bit of size - 1, minus log2(POOL_MIN_SIZE)
+    return (64 - __builtin_clzll(size - 1)) - __builtin_ctz(POOL_MIN_SIZE);
+}
+
+bool PoolInit(Pool *pool, Arena *arena)
+{
+    if (arena == NULL) return false;
+
+    pool->arena = arena;
+    PoolReset(pool);
+
+    return true;
+}
+
+void *PoolAlloc(Pool *pool, uint64_t size)
+{
+    if (size > POOL_MAX_SIZE) return NULL;
+
+    uint32_t sizeClass = PoolSizeClass(size);
+    uint64_t blockSize = (uint64_t)POOL_MIN_SIZE << sizeClass;
+
+    // Reuse a freed block first
+    PoolFreeNode *node = pool->freeLists[sizeClass];
+    if (node != NULL)
+    {
+        pool->freeLists[sizeClass] = node->next;
+        pool->liveBlocks[sizeClass]++;
+        return node;
+    }
+
+    // Otherwise carve the next block out of this class's slab, getting a new slab if it is used up
+    if (pool->slabCursor[sizeClass] == NULL || pool->slabCursor[sizeClass] + blockSize > pool->slabEnd[sizeClass])
+    {
+        unsigned char *slab = ArenaPushTagged(pool->arena, POOL_SLAB_SIZE, POOL_MIN_SIZE, "pool");
+        if (slab == NULL) return NULL;
+
+        pool->slabCursor[sizeClass] = slab;
+        pool->slabEnd[sizeClass] = slab + POOL_SLAB_SIZE;
+    }
+
+    void *block = pool->slabCursor[sizeClass];
+    pool->slabCursor[sizeClass] += blockSize;
+    pool->liveBlocks[sizeClass]++;
+
+    return block;
+}
+
+void PoolFree(Pool *pool, void *ptr, uint64_t size)
+{
+    if (ptr == NULL || size > POOL_MAX_SIZE) return;
+
+    uint32_t sizeClass = PoolSizeClass(size);
+
+    PoolFreeNode *node = ptr;
+    node->next = pool->freeLists[sizeClass];
+    pool->freeLists[sizeClass] = node;
+    pool->liveBlocks[sizeClass]--;
+}
+
+void PoolReset(Pool *pool)
+{
+    for (int i = 0; i < POOL_CLASS_COUNT; i++)
+    {
+        pool->freeLists[i] = NULL;
+        pool->slabCursor[i] = NULL;
+        pool->slabEnd[i] = NULL;
+        pool->liveBlocks[i] = 0;
+    }
+}
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////
@@ -0,0 +1,203 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../include/scheduler.h"
+#include "../include/jobs.h"
+#include "../include/platform.h"
+
+///////////////////////////////////////
+/// Dependency DAG ////////////////////
+///////////////////////////////////////
+
+static bool MasksOverlap(const uint64_t *a, const uint64_t *b)
+{
+    for (uint32_t i = 0; i < ECS_SIGNATURE_MAX_WORDS; i++)
+    {
+        if (a[i] & b[i]) return true;
+    }
+    return false;
+}
+
+// Two systems conflict if either writes something the other reads or writes, if both publish events,
+// or if either is structural
+static bool SystemsConflict(const SystemAccess *a, const SystemAccess *b)
+{
+    if (a->structural || b->structural) return true;
+    if (a->eventWrites != 0 && b->eventWrites != 0) return true;
+
+    if (MasksOverlap(a->writes, b->reads) || MasksOverlap(a->writes, b->writes) || MasksOverlap(b->writes, a->reads)) return true;
+    if ((a->eventWrites & b->eventReads) || (b->eventWrites & a->eventReads)) return true;
+    if ((a->resourceWrites & (b->resourceReads | b->resourceWrites)) || (b->resourceWrites & a->resourceReads)) return true;
+
+    return false;
+}
+
+// Rebuild the DAG from every system's access, a system waits on every earlier added one it conflicts with
+static void BuildGraph(Scheduler *scheduler)
+{
+    memset(scheduler->successors, 0, sizeof(scheduler->successors));
+    memset(scheduler->predecessors, 0, sizeof(scheduler->predecessors));
+
+    for (uint32_t j = 0; j < scheduler->systemCount; j++)
+    {
+        for (uint32_t i = 0; i < j; i++)
+        {
+            if (!SystemsConflict(&scheduler->systems[i].access, &scheduler->systems[j].access)) continue;
+
+            scheduler->successors[i] |= (uint64_t)1 << j;
+            scheduler->predecessors[j] |= (uint64_t)1 << i;
+        }
+    }
+}
+
+// Longest path through the DAG weighted by how long each system ran, added order is a topological order
+static void FindCriticalPath(Scheduler *scheduler)
+{
+    uint64_t pathNs[SCHEDULER_MAX_SYSTEMS];
+    uint32_t previous[SCHEDULER_MAX_SYSTEMS];
+    uint32_t last = SCHEDULER_NONE;
+    scheduler->criticalPathNs = 0;
+    scheduler->workNs = 0;
+
+    for (uint32_t j = 0; j < scheduler->systemCount; j++)
+    {
+        uint64_t duration = scheduler->systems[j].endNs - scheduler->systems[j].startNs;
+        scheduler->workNs += duration;
+
+        pathNs[j] = 0;
+        previous[j] = SCHEDULER_NONE;
+        uint64_t predecessors = scheduler->predecessors[j];
+        while (predecessors != 0)
+        {
+            uint32_t i = __builtin_ctzll(predecessors);
+            predecessors &= predecessors - 1;
+            if (pathNs[i] < pathNs[j]) continue;
+
+            pathNs[j] = pathNs[i];
+            previous[j] = i;
+        }
+        pathNs[j] += duration;
+
+        if (last == SCHEDULER_NONE || pathNs[j] > scheduler->criticalPathNs)
+        {
+            scheduler->criticalPathNs = pathNs[j];
+            last = j;
+        }
+    }
+
+    // Walked back from the end, then turned around so the path reads from first to last
+    uint32_t count = 0;
+    for (uint32_t s = last; s != SCHEDULER_NONE; s = previous[s]) scheduler->criticalPath[count++] = s;
+    for (uint32_t i = 0; i < count / 2; i++)
+    {
+        uint32_t swap = scheduler->criticalPath[i];
+        scheduler->criticalPath[i] = scheduler->criticalPath[count - 1 - i];
+        scheduler->criticalPath[count - 1 - i] = swap;
+    }
+    scheduler->criticalPathCount = count;
+}
+
+///////////////////////////////////////
+/// Running Systems ///////////////////
+///////////////////////////////////////
+
+// Job running system begin, then adding every successor it was the last predecessor of as a job
+static void RunSystemJob(void *data, uint32_t begin, uint32_t end)
+{
+    (void)end;
+    Scheduler *scheduler = data;
+    SchedulerSystem *system = &scheduler->systems[begin];
+    system->startNs = PlatformTimeNs();
+    system->func(system->context);
+    system->endNs = PlatformTimeNs();
+
+    // Successors are added before this job counts down running, so it never reaches 0 early
+    uint64_t successors = scheduler->successors[begin];
+    while (successors != 0)
+    {
+        uint32_t next = __builtin_ctzll(successors);
+        successors &= successors - 1;
+        if (__atomic_sub_fetch(&scheduler->pending[next], 1, __ATOMIC_ACQ_REL) == 0)
+        {
+            JobAdd(scheduler->jobs, RunSystemJob, scheduler, next, next + 1, &scheduler->running);
+        }
+    }
+}
+
+///////////////////////////////////////
+/// Scheduler /////////////////////////
+///////////////////////////////////////
+
+void SchedulerInit(Scheduler *scheduler, JobSystem *jobs)
+{
+    memset(scheduler, 0, sizeof(Scheduler));
+    scheduler->jobs = jobs;
+}
+
+uint32_t SchedulerAddSystem(Scheduler *scheduler, const char *name, SystemFunc func, void *context, SystemAccess access)
+{
+    if (scheduler->systemCount >= SCHEDULER_MAX_SYSTEMS || func == NULL) return SCHEDULER_NONE;
+
+    // Writing something means reading it too, as far as ordering goes
+    for (uint32_t i = 0; i < ECS_SIGNATURE_MAX_WORDS; i++) access.reads[i] |= access.writes[i];
+    access.resourceReads |= access.resourceWrites;
+
+    uint32_t index = scheduler->systemCount++;
+    SchedulerSystem *system = &scheduler->systems[index];
+    system->name = name;
+    system->func = func;
+    system->context = context;
+    system->access = access;
+    system->startNs = 0;
+    system->endNs = 0;
+
+    return index;
+}
+
+void SchedulerRun(Scheduler *scheduler)
+{
+    uint64_t start = PlatformTimeNs();
+    if (scheduler->systemCount == 0) return;
+
+    BuildGraph(scheduler);
+
+    // If every system waits on the one added before it the tick is one chain, and is just called in order,
+    // otherwise some system can run next to the one before it
+    bool parallel = false;
+    for (uint32_t s = 1; s < scheduler->systemCount && !parallel; s++)
+    {
+        parallel = (scheduler->predecessors[s] & ((uint64_t)1 << (s - 1))) == 0;
+    }
+
+    if (!parallel)
+    {
+        for (uint32_t s = 0; s < scheduler->systemCount; s++)
+        {
+            SchedulerSystem *system = &scheduler->systems[s];
+            system->startNs = PlatformTimeNs();
+            system->func(system->context);
+            system->endNs = PlatformTimeNs();
+        }
+    }
+    else
+    {
+        for (uint32_t s = 0; s < scheduler->systemCount; s++)
+        {
+            scheduler->pending[s] = __builtin_popcountll(scheduler->predecessors[s]);
+        }
+        scheduler->running.pending = 0;
+        // Roots are picked from the DAG, pending counts can already be changing once the first one is added
+        for (uint32_t s = 0; s < scheduler->systemCount; s++)
+        {
+            if (scheduler->predecessors[s] == 0) JobAdd(scheduler->jobs, RunSystemJob, scheduler, s, s + 1, &scheduler->running);
+        }
+        JobWait(scheduler->jobs, &scheduler->running);
+    }
+
+    scheduler->wallNs = PlatformTimeNs() - start;
+    FindCriticalPath(scheduler);
+}
+
+///////////////////////////////////////
+///////////////////////////////////////
+///////////////////////////////////////